@@ -0,0 +1,518 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include "utils.hpp"
+#include "Batch.hpp"
+
+
+using namespace std;
+
+
+
+const unordered_map<string, BatchRunner::BatchCommand> BatchRunner::commands = {
+    {"add_customer",            {2, 2, &BatchRunner::add_customer}},
+    {"delete_customer",         {2, 2, &BatchRunner::delete_customer}},
+    {"set_customer_name",       {3, 3, &BatchRunner::set_customer_name}},
+    {"set_customer_surname",    {3, 3, &BatchRunner::set_customer_surname}},
+    {"get_customer",            {2, 2, &BatchRunner::get_customer}},
+    {"list_customers",          {0, 0, &BatchRunner::list_customers}},
+    {"search_customers",        {1, 2, &BatchRunner::search_customers}},
+    {"add_contract",            {5, 5, &BatchRunner::add_contract}},
+    {"delete_contract",         {3, 3, &BatchRunner::delete_contract}},
+    {"set_contract_name",       {4, 4, &BatchRunner::set_contract_name}},
+    {"set_contract_datetime",   {4, 4, &BatchRunner::set_contract_datetime}},
+    {"set_contract_money",      {4, 4, &BatchRunner::set_contract_money}},
+    {"purge_contracts",         {3, 3, &BatchRunner::purge_contracts}},
+    {"search_contracts",        {0, 5, &BatchRunner::search_contracts}},
+    {"load",                    {1, 2, &BatchRunner::load}},
+    {"save",                    {1, 2, &BatchRunner::save}},
+    {"compact",                 {0, 0, &BatchRunner::compact}},
+    {"stats",                   {0, 0, &BatchRunner::stats}},
+};
+
+
+
+BatchRunner::BatchRunner(CRM& _crm, ostream& _output)
+    : crm(_crm), output(_output)
+{}
+
+
+size_t BatchRunner::get_executed_commands() const
+{
+    return this->executed_commands;
+}
+
+size_t BatchRunner::get_failed_commands() const
+{
+    return this->failed_commands;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// COMMAND PARSING AND DISPATCH
+
+
+bool BatchRunner::split_command_line(const string& line, vector<string>& words)
+{
+    words.clear();
+    size_t i = 0;
+    while(true){
+        while((i < line.size()) && isspace(static_cast<unsigned char>(line[i]))){
+            i++;
+        }
+        if(i == line.size()){
+            return true;
+        }
+
+        string word;
+        if(line[i] != '"'){
+            while((i < line.size()) && !(isspace(static_cast<unsigned char>(line[i])))){
+                word += line[i++];
+            }
+        }
+        else{
+            // quoted words are taken verbatim, whitespace included
+            i++;
+            while(true){
+                if(i == line.size()){
+                    return false;
+                }
+                if(line[i] == '"'){
+                    i++;
+                    break;
+                }
+                if((line[i] == '\\') && (i + 1 < line.size())){
+                    i++;
+                }
+                word += line[i++];
+            }
+        }
+        words.push_back(move(word));
+    }
+}
+
+
+size_t BatchRunner::run(istream& command_stream)
+{
+    (this->crm.get_logger())->logfile << "Batch process started..." << endl;
+
+    string line;
+    size_t line_number = 0;
+    while(getline(command_stream, line)){
+        line_number++;
+        if(!(line.empty()) && (line.back() == '\r')){
+            line.pop_back();
+        }
+        this->execute_line(line, line_number);
+    }
+    this->output.flush();
+
+    (this->crm.get_logger())->logfile << "Batch process completed: " << this->executed_commands << " commands, " << this->failed_commands << " failed." << endl << SEPARATOR_LINE << endl;
+    return this->failed_commands;
+}
+
+
+void BatchRunner::execute_line(const string& line, size_t line_number)
+{
+    vector<string> words;
+    bool complete = split_command_line(line, words);
+    if(complete && (words.empty() || (words[0][0] == '#'))){
+        return;
+    }
+
+    this->executed_commands++;
+    string command = words.empty() ? "" : words[0];
+    if(!(complete)){
+        this->write_error(command, line_number, "unterminated quote");
+        return;
+    }
+
+    auto entry = BatchRunner::commands.find(command);
+    if(entry == BatchRunner::commands.end()){
+        this->write_error(command, line_number, "unknown command");
+        return;
+    }
+
+    vector<string> arguments(words.begin() + 1, words.end());
+    const BatchCommand& batch_command = entry->second;
+    if((arguments.size() < batch_command.min_arguments) || (arguments.size() > batch_command.max_arguments)){
+        string expected = (batch_command.min_arguments == batch_command.max_arguments) ? to_string(batch_command.min_arguments)
+                            : to_string(batch_command.min_arguments) + " to " + to_string(batch_command.max_arguments);
+        this->write_error(command, line_number, "expected " + expected + " arguments, got " + to_string(arguments.size()));
+        return;
+    }
+
+    LOG_DEBUG(this->crm.get_logger(), "Executing batch command {} at line {}", command, line_number);
+    this->result_buffer.str("");
+    try{
+        JsonWriter result(this->result_buffer, false);
+        result.begin_object();
+        result.key("command");
+        result.value(command);
+        result.key("line");
+        result.value(line_number);
+        (this->*(batch_command.execute))(arguments, result);
+        result.key("status");
+        result.value("ok");
+        result.end_object();
+    }
+    catch(const exception& error){
+        this->write_error(command, line_number, error.what());
+        return;
+    }
+    this->output << this->result_buffer.str() << '\n';
+}
+
+
+void BatchRunner::write_error(const string& command, size_t line_number, string message)
+{
+    this->failed_commands++;
+    trim_string(message);
+    (this->crm.get_logger())->logfile << "Batch command " << command << " at line " << line_number << " failed: " << message << endl;
+
+    this->result_buffer.str("");
+    JsonWriter result(this->result_buffer, false);
+    result.begin_object();
+    result.key("command");
+    result.value(command);
+    result.key("error");
+    result.value(message);
+    result.key("line");
+    result.value(line_number);
+    result.key("status");
+    result.value("error");
+    result.end_object();
+    this->output << this->result_buffer.str() << '\n';
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// ARGUMENT CHECKS
+
+
+CustomerHandle BatchRunner::get_customer_handle(const string& name, const string& surname)
+{
+    CustomerHandle handle = this->crm.find_customer(name, surname);
+    if(handle.is_null()){
+        throw runtime_error("customer " + name + " " + surname + " not found");
+    }
+    return handle;
+}
+
+
+Customer* BatchRunner::get_customer(const string& name, const string& surname)
+{
+    return this->crm.get_customer(this->get_customer_handle(name, surname));
+}
+
+
+Contract BatchRunner::get_contract(Customer* customer, const string& contract_name)
+{
+    Contract contract = customer->get_contract_record().search_contract_duplicate(contract_name);
+    if(!(contract.is_valid())){
+        throw runtime_error("contract " + contract_name + " of customer " + customer->get_name() + " " + customer->get_surname() + " not found");
+    }
+    return contract;
+}
+
+
+float BatchRunner::parse_money(const string& argument)
+{
+    size_t parsed = 0;
+    float money = -1;
+    try{
+        money = stof(argument, &parsed);
+    }
+    catch(const exception&){
+        parsed = 0;
+    }
+    if((parsed == 0) || (parsed != argument.size()) || !(money >= 0)){
+        throw runtime_error("invalid amount of money " + argument + ": " + invalid_money_message);
+    }
+    return money;
+}
+
+
+void BatchRunner::check_datetime(const string& argument)
+{
+    if(!(validate_datetime_string(argument))){
+        throw runtime_error("invalid datetime " + argument + ": the datetime must be in the format " + date_format);
+    }
+}
+
+
+void BatchRunner::check_customer_name(string argument)
+{
+    if(argument.empty() || !(validate_only_alphabetical_string(argument))){
+        throw runtime_error("invalid name " + argument + ": names and surnames must be strictly alphabetical");
+    }
+}
+
+
+void BatchRunner::write_customer_id(JsonWriter& result, Customer& customer)
+{
+    result.begin_object();
+    result.key("name");
+    result.value(customer.get_name());
+    result.key("surname");
+    result.value(customer.get_surname());
+    result.end_object();
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// CUSTOMER COMMANDS
+
+
+void BatchRunner::add_customer(const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    check_customer_name(arguments[0]);
+    check_customer_name(arguments[1]);
+    if(!(this->crm.add_customer(arguments[0], arguments[1]))){
+        throw runtime_error("customer " + arguments[0] + " " + arguments[1] + " already exists");
+    }
+}
+
+
+void BatchRunner::delete_customer(const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    this->crm.delete_customer(this->get_customer_handle(arguments[0], arguments[1]));
+}
+
+
+void BatchRunner::set_customer_name(const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    CustomerHandle handle = this->get_customer_handle(arguments[0], arguments[1]);
+    check_customer_name(arguments[2]);
+    if(!(this->crm.edit_customer_id(handle, "name", arguments[2]))){
+        throw runtime_error("customer " + arguments[2] + " " + arguments[1] + " already exists");
+    }
+}
+
+
+void BatchRunner::set_customer_surname(const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    CustomerHandle handle = this->get_customer_handle(arguments[0], arguments[1]);
+    check_customer_name(arguments[2]);
+    if(!(this->crm.edit_customer_id(handle, "surname", arguments[2]))){
+        throw runtime_error("customer " + arguments[0] + " " + arguments[2] + " already exists");
+    }
+}
+
+
+void BatchRunner::get_customer(const vector<string>& arguments, JsonWriter& result)
+{
+    Customer* customer = this->get_customer(arguments[0], arguments[1]);
+    result.key("customer");
+    write_json(result, *customer);
+}
+
+
+void BatchRunner::list_customers([[maybe_unused]] const vector<string>& arguments, JsonWriter& result)
+{
+    CustomerStore& customer_record = this->crm.get_customer_record();
+    result.key("customers");
+    result.begin_array();
+    for(Customer& customer: customer_record){
+        write_customer_id(result, customer);
+    }
+    result.end_array();
+}
+
+
+void BatchRunner::search_customers(const vector<string>& arguments, JsonWriter& result)
+{
+    vector<CustomerHandle> matches = this->crm.search_customer_matches(arguments);
+    result.key("customers");
+    result.begin_array();
+    for(CustomerHandle handle: matches){
+        write_customer_id(result, *(this->crm.get_customer(handle)));
+    }
+    result.end_array();
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// CONTRACT COMMANDS
+
+
+void BatchRunner::add_contract(const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    Customer* customer = this->get_customer(arguments[0], arguments[1]);
+    float money = parse_money(arguments[3]);
+    check_datetime(arguments[4]);
+    if(!(this->crm.add_contract(customer, arguments[2], money, arguments[4]))){
+        throw runtime_error("contract " + arguments[2] + " of customer " + arguments[0] + " " + arguments[1] + " already exists");
+    }
+}
+
+
+void BatchRunner::delete_contract(const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    Customer* customer = this->get_customer(arguments[0], arguments[1]);
+    this->crm.delete_contract(customer, this->get_contract(customer, arguments[2]));
+}
+
+
+void BatchRunner::set_contract_name(const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    Customer* customer = this->get_customer(arguments[0], arguments[1]);
+    if(!(this->crm.set_contract_name(customer, this->get_contract(customer, arguments[2]), arguments[3]))){
+        throw runtime_error("contract " + arguments[3] + " of customer " + arguments[0] + " " + arguments[1] + " already exists");
+    }
+}
+
+
+void BatchRunner::set_contract_datetime(const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    Customer* customer = this->get_customer(arguments[0], arguments[1]);
+    Contract contract = this->get_contract(customer, arguments[2]);
+    check_datetime(arguments[3]);
+    string datetime_string = arguments[3];
+    this->crm.set_contract_datetime(customer, contract, datetime_string);
+}
+
+
+void BatchRunner::set_contract_money(const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    Customer* customer = this->get_customer(arguments[0], arguments[1]);
+    Contract contract = this->get_contract(customer, arguments[2]);
+    this->crm.set_contract_money(customer, contract, parse_money(arguments[3]));
+}
+
+
+void BatchRunner::purge_contracts(const vector<string>& arguments, JsonWriter& result)
+{
+    Customer* customer = this->get_customer(arguments[0], arguments[1]);
+    check_datetime(arguments[2]);
+    int32_t before_days;
+    parse_datetime_string(arguments[2], before_days);
+    result.key("deleted");
+    result.value(this->crm.purge_contracts(customer, before_days));
+}
+
+
+void BatchRunner::search_contracts(const vector<string>& arguments, JsonWriter& result)
+{
+    // each argument is a condition of the form field=value
+    ContractQuery query;
+    for(const string& argument: arguments){
+        size_t separator = argument.find('=');
+        string field = argument.substr(0, separator);
+        string value = (separator == string::npos) ? "" : argument.substr(separator + 1);
+
+        if(separator == string::npos){
+            throw runtime_error("invalid condition " + argument + ": conditions are written as field=value");
+        }
+        else if(field == "name"){
+            query.name_substring = value;
+        }
+        else if(field == "from"){
+            check_datetime(value);
+            parse_datetime_string(value, query.start_days);
+        }
+        else if(field == "to"){
+            check_datetime(value);
+            parse_datetime_string(value, query.end_days);
+        }
+        else if(field == "min"){
+            query.lower_money = parse_money(value);
+        }
+        else if(field == "max"){
+            query.upper_money = parse_money(value);
+        }
+        else{
+            throw runtime_error("unknown condition " + field + ": the conditions are name, from, to, min and max");
+        }
+    }
+
+    vector<ContractMatch> matches = this->crm.search_contracts(query);
+    result.key("contracts");
+    result.begin_array();
+    for(const ContractMatch& match: matches){
+        result.begin_object();
+        result.key("customer");
+        write_customer_id(result, *(match.customer));
+        result.key("datetime");
+        result.value(format_datetime_days(match.contract.get_datetime()));
+        result.key("money");
+        result.value(match.contract.get_money());
+        result.key("name");
+        result.value(match.contract.get_name());
+        result.end_object();
+    }
+    result.end_array();
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// DATA COMMANDS
+
+
+void BatchRunner::load(const vector<string>& arguments, JsonWriter& result)
+{
+    string policy = (arguments.size() > 1) ? arguments[1] : "keep";
+    if((policy != "keep") && (policy != "overwrite")){
+        throw runtime_error("invalid conflict policy " + policy + ": expected keep or overwrite");
+    }
+
+    size_t previous_customers = this->crm.get_customer_record().size();
+    vector<CustomerConflict> conflicts = this->crm.load_data(arguments[0]);
+
+    // the conflicts are listed before being resolved, as overwriting moves the incoming customers
+    result.key("conflicts");
+    result.begin_array();
+    for(CustomerConflict& conflict: conflicts){
+        write_customer_id(result, conflict.incoming);
+    }
+    result.end_array();
+    result.key("loaded");
+    result.value(this->crm.get_customer_record().size() - previous_customers);
+
+    if(policy == "overwrite"){
+        for(CustomerConflict& conflict: conflicts){
+            this->crm.overwrite_customer(conflict);
+        }
+    }
+    result.key("overwritten");
+    result.value((policy == "overwrite") ? conflicts.size() : 0);
+
+    // as in the menu, loaded data is persisted in the data store as a whole
+    this->crm.compact();
+}
+
+
+void BatchRunner::save(const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    if((arguments.size() > 1) && (arguments[1] != "compact")){
+        throw runtime_error("invalid option " + arguments[1] + ": expected compact");
+    }
+    this->crm.save_data(arguments[0], arguments.size() == 1);
+}
+
+
+void BatchRunner::compact([[maybe_unused]] const vector<string>& arguments, [[maybe_unused]] JsonWriter& result)
+{
+    this->crm.compact();
+}
+
+
+void BatchRunner::stats([[maybe_unused]] const vector<string>& arguments, JsonWriter& result)
+{
+    CustomerStore& customer_record = this->crm.get_customer_record();
+    size_t contracts = 0;
+    for(Customer& customer: customer_record){
+        contracts += customer.get_contract_record().size();
+    }
+    result.key("contracts");
+    result.value(contracts);
+    result.key("customers");
+    result.value(customer_record.size());
+}
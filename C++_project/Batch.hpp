@@ -0,0 +1,146 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <unordered_map>
+#include "CRM.hpp"
+#include "JsonWriter.hpp"
+
+
+using namespace std;
+
+
+/////////////////////////////////////////////////////////////////////
+// Batch mode: a file of commands executed without user interaction, one command per line.
+//
+// A line is a command followed by its arguments, separated by whitespace. Arguments containing whitespace (such as most contract names)
+// are written between double quotes, in which \" and \\ stand for a quote and a backslash. Empty lines and lines starting with # are skipped.
+// Customers are identified by their exact name and surname, contracts by their exact name. Datetimes are in the date_format format.
+//
+//     add_customer NAME SURNAME
+//     delete_customer NAME SURNAME
+//     set_customer_name NAME SURNAME NEW_NAME
+//     set_customer_surname NAME SURNAME NEW_SURNAME
+//     get_customer NAME SURNAME                            the customer with its contracts, as in the json data files
+//     list_customers                                       names and surnames of all the customers
+//     search_customers WORD [WORD]                         fuzzy search by name and/or surname, as in the menu
+//     add_contract NAME SURNAME CONTRACT MONEY DATETIME
+//     delete_contract NAME SURNAME CONTRACT
+//     set_contract_name NAME SURNAME CONTRACT NEW_NAME
+//     set_contract_datetime NAME SURNAME CONTRACT DATETIME
+//     set_contract_money NAME SURNAME CONTRACT MONEY
+//     purge_contracts NAME SURNAME DATETIME                deletes the contracts of the customer signed before DATETIME
+//     search_contracts [name=TEXT] [from=DATETIME] [to=DATETIME] [min=MONEY] [max=MONEY]
+//                                                          contracts of all the customers matching every condition given
+//     load PATH [keep|overwrite]                           loads a file, snapshot or directory. Customers already existing are kept by default
+//     save PATH [compact]                                  saves to json (indented unless compact) or to a snapshot, by the extension of the path
+//     compact                                              folds the journal of the data store into a new snapshot
+//     stats                                                number of customers and contracts
+//
+// The results are written as JSON Lines: one compact json object per command, in the order of the commands, with the keys
+// "command", "line" (line number in the command file), the results of the command if any, and "status", either "ok" or "error".
+// Failed commands carry an "error" message instead of results and do not stop the batch.
+
+
+/**
+ * @class BatchRunner
+ * @brief Executes the commands of a batch file on a CRM and writes a machine-readable result for each of them.
+ *
+ * The runner only goes through the public methods of the CRM, the same ones the menus use, so edits are journaled as usual when a data store is open.
+ */
+class BatchRunner
+{
+    private:
+        CRM& crm;
+        ostream& output;
+
+        // the result of the command being executed is written here first, so that a command failing halfway leaves no partial result
+        ostringstream result_buffer;
+
+        size_t executed_commands = 0;
+        size_t failed_commands = 0;
+
+        // handler of a command: executes it with the given arguments and writes its results, or throws
+        typedef void (BatchRunner::*CommandHandler)(const vector<string>& arguments, JsonWriter& result);
+
+        struct BatchCommand
+        {
+            size_t min_arguments;
+            size_t max_arguments;
+            CommandHandler execute;
+        };
+
+        static const unordered_map<string, BatchCommand> commands;
+
+        /** Splits a command line into words, handling quoted arguments
+         * @param line: the command line
+         * @param words: vector the words are written to
+         * @returns false if a quote is not closed
+        */
+        static bool split_command_line(const string& line, vector<string>& words);
+
+        /** Executes the command of a line and writes its result line */
+        void execute_line(const string& line, size_t line_number);
+
+        /** Writes the result line of a failed command */
+        void write_error(const string& command, size_t line_number, string message);
+
+        /** Retrieves the handle of the customer with the given name and surname, throws if it does not exist */
+        CustomerHandle get_customer_handle(const string& name, const string& surname);
+
+        /** Retrieves the customer with the given name and surname, throws if it does not exist */
+        Customer* get_customer(const string& name, const string& surname);
+
+        /** Retrieves the contract with the given name of a customer, throws if it does not exist */
+        Contract get_contract(Customer* customer, const string& contract_name);
+
+        /** Converts an argument to a non-negative amount of money, throws if it is not one */
+        static float parse_money(const string& argument);
+
+        /** Throws if an argument is not a valid datetime string */
+        static void check_datetime(const string& argument);
+
+        /** Throws if a customer name or surname is not strictly alphabetical */
+        static void check_customer_name(string argument);
+
+        static void write_customer_id(JsonWriter& result, Customer& customer);
+
+        // command handlers, see the list of commands above
+        void add_customer(const vector<string>& arguments, JsonWriter& result);
+        void delete_customer(const vector<string>& arguments, JsonWriter& result);
+        void set_customer_name(const vector<string>& arguments, JsonWriter& result);
+        void set_customer_surname(const vector<string>& arguments, JsonWriter& result);
+        void get_customer(const vector<string>& arguments, JsonWriter& result);
+        void list_customers(const vector<string>& arguments, JsonWriter& result);
+        void search_customers(const vector<string>& arguments, JsonWriter& result);
+        void add_contract(const vector<string>& arguments, JsonWriter& result);
+        void delete_contract(const vector<string>& arguments, JsonWriter& result);
+        void set_contract_name(const vector<string>& arguments, JsonWriter& result);
+        void set_contract_datetime(const vector<string>& arguments, JsonWriter& result);
+        void set_contract_money(const vector<string>& arguments, JsonWriter& result);
+        void purge_contracts(const vector<string>& arguments, JsonWriter& result);
+        void search_contracts(const vector<string>& arguments, JsonWriter& result);
+        void load(const vector<string>& arguments, JsonWriter& result);
+        void save(const vector<string>& arguments, JsonWriter& result);
+        void compact(const vector<string>& arguments, JsonWriter& result);
+        void stats(const vector<string>& arguments, JsonWriter& result);
+
+    public:
+
+        /** Public constructor for the BatchRunner class
+         * @param _crm: the CRM the commands are executed on
+         * @param _output: stream the result lines are written to
+         */
+        BatchRunner(CRM& _crm, ostream& _output);
+
+        /** Executes all the commands of a stream, in order
+         * @param command_stream: stream of command lines
+         * @returns the number of commands that failed
+         */
+        size_t run(istream& command_stream);
+
+        size_t get_executed_commands() const;
+        size_t get_failed_commands() const;
+};
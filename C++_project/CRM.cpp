@@ -4,9 +4,15 @@
 #include <fstream>
 #include <algorithm>
 #include <filesystem>
+#include <functional>
+#include <thread>
+#include <future>
+#include <mutex>
+#include <condition_variable>
 #include "utils.hpp"
 #include "Customer.hpp"
 #include "CRM.hpp"
+#include "Snapshot.hpp"
 
 
 
@@ -19,9 +25,9 @@ using json = nlohmann::json; // json library https://github.com/nlohmann/json/re
 
 CRM::CRM(){}
 
-CRM::CRM(string logfile_path){
+CRM::CRM(string logfile_path, LoggerOptions logger_options, string store_directory){
 
-    this->logger = make_shared<Logger>(logfile_path);
+    this->logger = make_shared<Logger>(logfile_path, logger_options);
 
 
     Customer::logger = this->logger;
@@ -29,26 +35,34 @@ CRM::CRM(string logfile_path){
     Contract::logger = this->logger;
 
     this->customer_menu_possible_actions = 5;
-    this->main_menu_possible_actions = 6;
+    this->main_menu_possible_actions = 7;
     this->edit_customer_menu_possible_actions = 3;
-    this->search_contract_menu_possible_actions = 4;
+    this->search_contract_menu_possible_actions = 6;
     this->contract_menu_possible_actions = 4;
     this->edit_contract_menu_possible_actions = 5;
 
-    // call the main menu upon creation
-    this->main_menu();
+    if(!(store_directory.empty())){
+        this->open_store(store_directory);
+    }
 }
 
 
-vector<Customer>& CRM::get_customer_record(){
+CustomerStore& CRM::get_customer_record(){
     return this->customer_record;
 }
 
 
+shared_ptr<Logger> CRM::get_logger(){
+    return this->logger;
+}
+
+
 void CRM::sort_alphabetically()
 {
     (this->logger)->logfile << "Sorting customer list...";
-    sort(this->customer_record.begin(), customer_record.end(), Person::compare_names_alphabetically);
+    this->customer_record.sort([this](uint32_t a, uint32_t b){
+        return Person::compare_names_alphabetically(this->customer_record.get_slot(a), this->customer_record.get_slot(b));
+    });
     (this->logger)->logfile << "Done" << endl << SEPARATOR_LINE << endl;
 }
 
@@ -78,25 +92,29 @@ void CRM::add_customer_CLI()
     name = user_input_strings[0];
     surname = user_input_strings[1];
     
-    this->add_customer(name, surname);
+    if(!(this->add_customer(name, surname))){
+        cout << "A customer named " << name << " " << surname << " already exists." << endl;
+    }
     (this->logger)->logfile << "Adding new customer process completed." << endl << SEPARATOR_LINE << endl;
 
 }
 
 
 
-void CRM::delete_customer(Customer* customer)
+void CRM::delete_customer(CustomerHandle handle)
 {        
-    // find the iterator of the object to be deleted, use a lambda function for brevity
-    auto iterator = find_if(this->customer_record.begin(), this->customer_record.end(), [customer](Customer& obj) { return &obj == customer; });
-    if (iterator != this->customer_record.end()) {
-        this->customer_record.erase(iterator);
+    Customer* customer = this->customer_record.get(handle);
+    if (customer != nullptr) {
+        this->journal_edit({JournalRecordType::delete_customer, customer->get_name(), customer->get_surname()});
+        // the other customers keep their slots, so only the deleted customer leaves the indexes
+        this->unindex_customer(handle.slot);
+        this->customer_record.erase(handle);
         (this->logger)->logfile << " Done" << endl << SEPARATOR_LINE << endl;
         return;
     }
     else{
-        (this->logger)->logfile << endl << "An error occurred trying to delete customer " << customer->get_name() << " " << customer->get_surname() << endl;
-        throw runtime_error("\nAn error occurred trying to delete customer " + customer->get_name() + " " + customer->get_surname() + "\n");
+        (this->logger)->logfile << endl << "An error occurred trying to delete a customer which does not exist" << endl;
+        throw runtime_error("\nAn error occurred trying to delete a customer which does not exist\n");
     }
 }
 
@@ -104,65 +122,145 @@ void CRM::delete_customer(Customer* customer)
 
 
 
-void CRM::add_customer(string name, string surname)
+bool CRM::add_customer(string name, string surname)
 {
     (this->logger)->logfile << "Adding customer " << name << " " << surname << "..." << endl;
 
     // check if a customer with the same name already exists 
     (this->logger)->logfile << "Looking for potential duplicates of " << name << " " << surname << "...";
-    vector<string> new_customer_id = {name, surname};
-    vector<Customer*> potential_matches = this->search_customer_matches(new_customer_id);
-
+    CustomerHandle duplicate = this->find_customer(name, surname);
     (this->logger)->logfile << " Done" << endl;
 
-    if(potential_matches.size()!=0)
+    if(!(duplicate.is_null()))
     {
-        for(Customer* customer: potential_matches)
-        {
-            if((customer->get_name() == name) and (customer->get_surname() == surname)){
-                cout << "A customer named " << name << " " << surname << " already exists." << endl;
-                (this->logger)->logfile << "Adding customer not executed due to existing duplicate" << endl << SEPARATOR_LINE << endl;
-                return;
-            }
-        }
+        (this->logger)->logfile << "Adding customer not executed due to existing duplicate" << endl << SEPARATOR_LINE << endl;
+        return false;
     }
 
     // add the customer to the customer list if no duplicate exists
-    this->customer_record.push_back(Customer(name, surname));
+    CustomerHandle handle = this->customer_record.insert(Customer(name, surname));
+    this->index_customer(handle.slot);
+    this->journal_edit({JournalRecordType::add_customer, name, surname});
     (this->logger)->logfile << "Customer " << name << " " << surname << " Added." << endl;
+    return true;
 }
 
 
 
-// I tried to implement a fuzzy search functionality: the user can enter either one or two keywords. When entering only one keyword, that can be either the name or the surname. 
-// A given customer is considered a potential match for the query if at least one of the user input words is a (case-insensitive) substring of the contact's name or surname.
-vector<Customer*> CRM::search_customer_matches(vector<string> user_input_strings)
+string CRM::customer_key(const string& name, const string& surname)
 {
-    vector<Customer*> potential_matches;
+    // names are strictly alphabetical, so a control character is a safe separator between name and surname
+    return to_lowercase(name) + '\x1f' + to_lowercase(surname);
+}
 
-    string customer_name;
-    string customer_surname;
 
+void CRM::index_customer(uint32_t slot)
+{
+    Customer& customer = this->customer_record.get_slot(slot);
+    this->customer_index[customer_key(customer.get_name(), customer.get_surname())].push_back(slot);
+
+    // grams never span across name and surname, as matching is done on each of them separately
+    vector<uint32_t> grams;
+    collect_grams(to_lowercase(customer.get_name()), grams);
+    collect_grams(to_lowercase(customer.get_surname()), grams);
+    stamped_gram_index_insert(this->customer_grams, grams, slot);
+}
 
-    for(Customer& customer: this->customer_record){
 
-        // make everyhting lowercase to enhance flexibility
-        customer_name = to_lowercase(customer.get_name());
-        customer_surname = to_lowercase(customer.get_surname());
+void CRM::unindex_customer(uint32_t slot)
+{
+    Customer& customer = this->customer_record.get_slot(slot);
+    auto bucket = this->customer_index.find(customer_key(customer.get_name(), customer.get_surname()));
+    if(bucket == this->customer_index.end()){
+        return;
+    }
+
+    vector<uint32_t>& slots = bucket->second;
+    slots.erase(remove(slots.begin(), slots.end(), slot), slots.end());
+    if(slots.empty()){
+        this->customer_index.erase(bucket);
+    }
 
-        for(string word: user_input_strings){
-            word = to_lowercase(word);
-            if(customer_name.find(word) != string::npos){
-                    potential_matches.push_back(&customer);
-                    break;
-            }
-            else if(customer_surname.find(word) != string::npos){
-                    potential_matches.push_back(&customer);
-                    break;
-            }
+    vector<uint32_t> grams;
+    collect_grams(to_lowercase(customer.get_name()), grams);
+    collect_grams(to_lowercase(customer.get_surname()), grams);
+    stamped_gram_index_erase(this->customer_grams, grams, slot);
+}
+
+
+CustomerHandle CRM::find_customer(const string& name, const string& surname)
+{
+    auto bucket = this->customer_index.find(customer_key(name, surname));
+    if(bucket == this->customer_index.end()){
+        return CustomerHandle();
+    }
+
+    // the key is case-insensitive, so the exact match is checked among the (few) customers sharing it
+    for(uint32_t slot: bucket->second){
+        Customer& customer = this->customer_record.get_slot(slot);
+        if((customer.get_name() == name) and (customer.get_surname() == surname)){
+            return this->customer_record.get_handle(slot);
         }
     }
-    
+    return CustomerHandle();
+}
+
+
+Customer* CRM::get_customer(CustomerHandle handle)
+{
+    return this->customer_record.get(handle);
+}
+
+
+
+void CRM::search_customer_word(const string& word, vector<uint32_t>& slots)
+{
+    // the empty string is a substring of any name
+    if(word.empty()){
+        for(auto iterator = this->customer_record.begin(); iterator != this->customer_record.end(); ++iterator){
+            slots.push_back(iterator.handle().slot);
+        }
+        return;
+    }
+
+    vector<uint32_t> candidates;
+    if(stamped_gram_index_candidates(this->customer_grams, word, candidates)){
+        slots.insert(slots.end(), candidates.begin(), candidates.end());
+        return;
+    }
+
+    // the candidates still need to be verified
+    for(uint32_t slot: candidates){
+        Customer& customer = this->customer_record.get_slot(slot);
+        if((to_lowercase(customer.get_name()).find(word) != string::npos) || (to_lowercase(customer.get_surname()).find(word) != string::npos)){
+            slots.push_back(slot);
+        }
+    }
+}
+
+
+// I tried to implement a fuzzy search functionality: the user can enter either one or two keywords. When entering only one keyword, that can be either the name or the surname. 
+// A given customer is considered a potential match for the query if at least one of the user input words is a (case-insensitive) substring of the contact's name or surname.
+// The candidates are retrieved through the gram index rather than by scanning all the customers.
+vector<CustomerHandle> CRM::search_customer_matches(vector<string> user_input_strings)
+{
+    vector<CustomerHandle> potential_matches;
+    vector<uint32_t> matching_slots;
+
+    for(const string& word: user_input_strings){
+        this->search_customer_word(to_lowercase(word), matching_slots);
+    }
+
+    // a customer matching more than one word is reported once, and matches are kept in the order of the customer record
+    sort(matching_slots.begin(), matching_slots.end());
+    matching_slots.erase(unique(matching_slots.begin(), matching_slots.end()), matching_slots.end());
+    sort(matching_slots.begin(), matching_slots.end(), [this](uint32_t a, uint32_t b){
+        return this->customer_record.get_order_position(a) < this->customer_record.get_order_position(b);
+    });
+
+    for(uint32_t slot: matching_slots){
+        potential_matches.push_back(this->customer_record.get_handle(slot));
+    }
     return potential_matches;
 }
 
@@ -181,16 +279,15 @@ void CRM::print_customer_list()
 
     string name, surname;
     cout << "Customer list:" << endl << endl;
-    for(int i  = 0; i < customer_record.size(); i++)
+    int i = 0;
+    for(Customer& customer: this->customer_record)
     {
-
-        Customer customer=this->customer_record[i];
         name = customer.get_name();
         surname = customer.get_surname();
 
-        cout << i+1 << ") ";
+        cout << ++i << ") ";
         (this->logger)->logfile << "Printing id information for customer " << name << " " << surname << "...";
-        customer_record[i].print_id();
+        customer.print_id();
         (this->logger)->logfile << " Done" << endl;
         cout << endl;
     }
@@ -203,7 +300,7 @@ void CRM::search_customer_CLI()
 {
 
     (this->logger)->logfile << "Search customer process started... " << endl;
-    Customer* selected_customer;
+    CustomerHandle selected_customer;
 
     string prompt = "Enter the name and/or of the customer (only alphabetical characters). Type 'q' to cancel the operation.\n" ;
     vector<string> user_input_strings;
@@ -222,14 +319,13 @@ void CRM::search_customer_CLI()
             return;
         }
 
-        (this->logger)->logfile << "Validating number of user input words... ";
         // check that the user has entered at most two words
         if(user_input_strings.size() > 2){
             cout << "You can type at most two words. Try again." << endl;
-            (this->logger)->logfile << "Not valid" << endl;
+            LOG_TRACE(this->logger, "Validating number of user input words... Not valid");
             continue;
         }
-        (this->logger)->logfile << "Validated" << endl;
+        LOG_TRACE(this->logger, "Validating number of user input words... Validated");
         break;
 
     }
@@ -246,7 +342,7 @@ void CRM::search_customer_CLI()
     ////////////////////////////////////////////////
     // open the selected customer menu if a matching customer is found or if a customer is selected among potential mathing customers
 
-    if(selected_customer == nullptr){
+    if(selected_customer.is_null()){
         return;
     }
     else{
@@ -259,13 +355,13 @@ void CRM::search_customer_CLI()
 
 
 
-Customer* CRM::select_customer(vector<string> user_input_strings, bool CLI_mode)
+CustomerHandle CRM::select_customer(const vector<string>& user_input_strings, bool CLI_mode)
 {
 
     ////////////////////////////////////////////////////////////
     /// build a potential customer name by using the user input strings
     string potential_customer_name = "";
-    for(string word: user_input_strings){
+    for(const string& word: user_input_strings){
         potential_customer_name += word;
         potential_customer_name += " ";
     }
@@ -273,47 +369,41 @@ Customer* CRM::select_customer(vector<string> user_input_strings, bool CLI_mode)
     trim_string(potential_customer_name);
 
 
+    ////////////////////////////////////////////////////////////
+    /// if the user entered both name and surname check for a perfect match first, this only needs a lookup in the hash index
+    if(user_input_strings.size()==2){
+        CustomerHandle exact_match = this->find_customer(user_input_strings[0], user_input_strings[1]);
+        if(!(exact_match.is_null())){
+            return exact_match;
+        }
+    }
+
+    // if the function is being called when loading data from a file, we only need to verify that an existing customer with the same name was not already present. So, at this point,
+    // we can directly retun a null handle to indicate that no duplicate was found.
+    if(!(CLI_mode)){     
+        return CustomerHandle();
+    }
+
+
     ////////////////////////////////////////////////////////////
     /// fuzzy search for matches
-    vector<Customer*> potential_matches = this->search_customer_matches(user_input_strings);
+    vector<CustomerHandle> potential_matches = this->search_customer_matches(user_input_strings);
 
 
     if(potential_matches.size()==0) // no match found
     {
-        if((CLI_mode)){
-            cout << endl << "No match was found for " << potential_customer_name << endl << SEPARATOR_LINE << endl;
-        }
-        return nullptr;
+        cout << endl << "No match was found for " << potential_customer_name << endl << SEPARATOR_LINE << endl;
+        return CustomerHandle();
 
     }
     else{
 
-        if(user_input_strings.size()==2){   // if the user entered both name and surname we check for a perfect match
-            string name = user_input_strings[0];
-            string surname = user_input_strings[1];
-
-            for(Customer* potential_match: potential_matches){
-                        if((potential_match->get_name() == name) and (potential_match->get_surname() == surname))  // if a perfect match is found (both name and surname correspond)
-                        {
-                            return potential_match;
-                        }
-            }  
-        }
-
-        // if the function is being called when loading data from a file, we only need to verify that an existing customer with the same name was not already present. So, at this point,
-        // we can directly retun a null pointer to indicate that no duplicate was found.
-        if(!(CLI_mode)){     
-            return nullptr;
-        }
-        
-
         // if an exact match was not found but at least a potential match was found, give the user the chance to select one of the potential matches
         cout << endl << "No exact match was found. Did you mean one of these customers?" << endl;
-        Customer customer;
         for(int i =0; i < potential_matches.size(); i++)
         {
-            customer = *(potential_matches[i]);
-            cout << i+1 << ") " << (customer).get_name() << " " << (customer).get_surname() << endl;
+            Customer* customer = this->customer_record.get(potential_matches[i]);
+            cout << i+1 << ") " << customer->get_name() << " " << customer->get_surname() << endl;
         }
 
         int user_choice;
@@ -321,11 +411,11 @@ Customer* CRM::select_customer(vector<string> user_input_strings, bool CLI_mode)
 
         read_user_menu_choice(user_choice, potential_matches.size(), prompt, this->logger, true);
 
-        // if the user entered -1 return a null pointer
+        // if the user entered -1 return a null handle
         if(user_choice == -1){
                      cout << endl << "Operation Cancelled." << endl << SEPARATOR_LINE  << endl;
                     (this->logger)->logfile << "Operation cancelled by the user" << endl << SEPARATOR_LINE << endl;
-                    return nullptr;
+                    return CustomerHandle();
         }
         
         return potential_matches[user_choice-1];
@@ -337,8 +427,9 @@ Customer* CRM::select_customer(vector<string> user_input_strings, bool CLI_mode)
 
 
 
-void CRM::edit_customer_id_CLI(Customer* customer, string id_field){
+void CRM::edit_customer_id_CLI(CustomerHandle handle, string id_field){
     
+    Customer* customer = this->customer_record.get(handle);
 
     (this->logger)->logfile << "Process for editing " << id_field <<  " for customer" << customer->get_name() << " " << customer->get_surname() << "started ..." << endl;
 
@@ -362,23 +453,133 @@ void CRM::edit_customer_id_CLI(Customer* customer, string id_field){
 
     ////////////////////////////////////////////////
     // After reading and parsing user input, edit coustomer's field
+    if(!(this->edit_customer_id(handle, id_field, new_value))){
+        cout << "Another customer is already named " << ((id_field == "name") ? new_value : customer->get_name()) << " "
+             << ((id_field == "surname") ? new_value : customer->get_surname()) << ", the " << id_field << " was not changed." << endl;
+    }
+
+    (this->logger)->logfile << "Process for editing " << id_field <<  " for customer" << customer->get_name() << " " << customer->get_surname() << "completed ..." << endl;
+
+}
+
+
+
+
+
+bool CRM::edit_customer_id(CustomerHandle handle, const string& id_field, const string& new_value){
+
+    Customer* customer = this->customer_record.get(handle);
+    if(customer == nullptr){
+        throw runtime_error("\nAn error occurred trying to edit a customer which does not exist\n");
+    }
+
+    // customers are identified by name and surname (also in the journal), so the edit must not make two of them share both
+    const string& new_name = (id_field == "name") ? new_value : customer->get_name();
+    const string& new_surname = (id_field == "surname") ? new_value : customer->get_surname();
+    CustomerHandle duplicate = this->find_customer(new_name, new_surname);
+    if(!(duplicate.is_null()) && (duplicate.slot != handle.slot)){
+        (this->logger)->logfile << "Editing customer " << customer->get_name() << " " << customer->get_surname() << " not executed: a customer named "
+                                << new_name << " " << new_surname << " already exists" << endl;
+        return false;
+    }
+
+    JournalRecord record = {JournalRecordType::set_customer_name, customer->get_name(), customer->get_surname()};
+    record.new_value = new_value;
+
+    // the customer is keyed by name and surname, so it is taken out of the index before the edit and put back afterwards
+    this->unindex_customer(handle.slot);
+
     if(id_field == "name"){
             customer->set_name(new_value);
     }
     else if(id_field == "surname"){
             customer->set_surname(new_value);
+            record.type = JournalRecordType::set_customer_surname;
     }
     else{
+        this->index_customer(handle.slot);
         throw runtime_error("\nSomething went wrong in setting a new id field for customer " + customer->get_name() + " " + customer->get_surname() + "\n");
         (this->logger)->logfile << "Something went wrong in setting a new id field for customer " + customer->get_name() + " " + customer->get_surname() << endl;
 
     }
 
-    (this->logger)->logfile << "Process for editing " << id_field <<  " for customer" << customer->get_name() << " " << customer->get_surname() << "completed ..." << endl;
+    this->index_customer(handle.slot);
+    this->journal_edit(record);
+    return true;
+}
+
+
+bool CRM::add_contract(Customer* customer, string contract_name, float money, string datetime_string){
 
+    ContractRecord& contract_record = customer->get_contract_record();
+
+    // nothing is added if a contract with the same name exists
+    if(!(contract_record.add_contract(contract_name, money, datetime_string))){
+        return false;
+    }
+
+    JournalRecord record = {JournalRecordType::add_contract, customer->get_name(), customer->get_surname(), contract_name};
+    record.money = money;
+    record.datetime = contract_record.search_contract_duplicate(contract_name).get_datetime();
+    this->journal_edit(record);
+    return true;
+}
+
+
+void CRM::delete_contract(Customer* customer, Contract contract){
+
+    JournalRecord record = {JournalRecordType::delete_contract, customer->get_name(), customer->get_surname(), string(contract.get_name())};
+    customer->get_contract_record().delete_contract(contract);
+    this->journal_edit(record);
+}
+
+
+size_t CRM::purge_contracts(Customer* customer, int32_t before_days){
+
+    if(before_days == numeric_limits<int32_t>::min()){
+        return 0;
+    }
+
+    // the handles to the contracts still to delete stay valid while the others are deleted
+    vector<Contract> expired_contracts = customer->get_contract_record().search_contracts_by_datetime(numeric_limits<int32_t>::min(), before_days - 1);
+    (this->logger)->logfile << "Deleting the " << expired_contracts.size() << " contracts of " << customer->get_name() << " " << customer->get_surname() << " signed before " << format_datetime_days(before_days) << "...";
+    for(Contract& contract: expired_contracts){
+        this->delete_contract(customer, contract);
+    }
+    (this->logger)->logfile << " Done" << endl;
+    return expired_contracts.size();
+}
+
+
+bool CRM::set_contract_name(Customer* customer, Contract contract, const string& new_name){
+
+    JournalRecord record = {JournalRecordType::set_contract_name, customer->get_name(), customer->get_surname(), string(contract.get_name()), new_name};
+    if(!(contract.set_name(new_name))){
+        return false;
+    }
+    this->journal_edit(record);
+    return true;
+}
+
+
+void CRM::set_contract_datetime(Customer* customer, Contract contract, string& new_datetime_string){
+
+    contract.set_datetime(new_datetime_string);
+
+    JournalRecord record = {JournalRecordType::set_contract_datetime, customer->get_name(), customer->get_surname(), string(contract.get_name())};
+    record.datetime = contract.get_datetime();
+    this->journal_edit(record);
 }
 
 
+void CRM::set_contract_money(Customer* customer, Contract contract, float new_money){
+
+    contract.set_money(new_money);
+
+    JournalRecord record = {JournalRecordType::set_contract_money, customer->get_name(), customer->get_surname(), string(contract.get_name())};
+    record.money = new_money;
+    this->journal_edit(record);
+}
 
 
 
@@ -416,8 +617,9 @@ void CRM::add_contract_CLI(Customer* customer)
 
 
     // combining back the parsed strings into a single string
-    for(string input_string: user_input_strings){
-        contract_name += (input_string + " ");
+    for(const string& input_string: user_input_strings){
+        contract_name += input_string;
+        contract_name += ' ';
     }
 
     // clear vector before proceeding
@@ -443,7 +645,9 @@ void CRM::add_contract_CLI(Customer* customer)
     ////////////////////////////////////////////////
     // After reading and parsing user input, add the new contract
     
-    customer->get_contract_record().add_contract(contract_name, money, datetime_string);
+    if(!(this->add_contract(customer, contract_name, money, datetime_string))){
+        cout << "A contract named " << contract_name << " already exists." << endl;
+    }
 
 
     cout << SEPARATOR_LINE << endl;
@@ -470,9 +674,10 @@ Please choose an option below:
 1: Add a new customer
 2: View all customers
 3: Search for a customer by name and/or surname
-4: Save all customer data to file
-5: Load customer data from file
-6: Exit the application
+4: Search contracts across all customers
+5: Save all customer data to file
+6: Load customer data from file
+7: Exit the application
 
 
 ===============================================================
@@ -496,12 +701,15 @@ Please choose an option below:
                     this->search_customer_CLI();
                     break;
                 case 4:
-                    this->save_CLI();
+                    this->search_all_contracts_CLI();
                     break;
                 case 5:
-                    this->load_CLI();
+                    this->save_CLI();
                     break;
                 case 6:
+                    this->load_CLI();
+                    break;
+                case 7:
                     cout << endl << "Closing application..." << endl << SEPARATOR_LINE << endl;
                     exit_menu = true;
 
@@ -514,7 +722,7 @@ Please choose an option below:
 
 
 
-void CRM::customer_menu(Customer* customer)
+void CRM::customer_menu(CustomerHandle handle)
 {
     (this->logger)->logfile << "Opening Customer Menu" << endl << SEPARATOR_LINE << endl;
 
@@ -524,7 +732,11 @@ void CRM::customer_menu(Customer* customer)
     string prompt =   format("Enter your choice (1–{}): ", this->customer_menu_possible_actions);
 
     while(!(exit_menu)){  
-    
+        // the handle is resolved again at each step, as the customer may no longer exist
+        Customer* customer = this->customer_record.get(handle);
+        if(customer == nullptr){
+            break;
+        }
 
             menu_message = R"(
 ==================== Customer Menu ====================
@@ -552,14 +764,14 @@ Please choose an option below:
                 (this->logger)->logfile << SEPARATOR_LINE << endl;
                 break;
             case 2:
-                this->edit_customer_menu(customer);
+                this->edit_customer_menu(handle);
                 break;
             case 3:
                 this->contract_menu(customer);
                 break;
             case 4:
                 (this->logger)->logfile << "Deleting customer " << customer->get_name() << " " << customer->get_surname() << "...";
-                this->delete_customer(customer);
+                this->delete_customer(handle);
                 exit_menu = true;
                 break;
             case 5:
@@ -571,7 +783,7 @@ Please choose an option below:
 }
 
 
-void CRM::edit_customer_menu(Customer* customer)
+void CRM::edit_customer_menu(CustomerHandle handle)
 {
 
     (this->logger)->logfile << "Opening Edit Customer Menu" << endl << SEPARATOR_LINE << endl;
@@ -584,6 +796,10 @@ void CRM::edit_customer_menu(Customer* customer)
 
     while(!(exit_menu))
     {        
+        Customer* customer = this->customer_record.get(handle);
+        if(customer == nullptr){
+            break;
+        }
         menu_message = R"(
 ==================== Edit Customer Menu ====================
 
@@ -603,10 +819,10 @@ Please choose an option below:
 
         switch(user_choice){
             case 1:
-                this->edit_customer_id_CLI(customer, "name");
+                this->edit_customer_id_CLI(handle, "name");
                 break;
             case 2:
-                this->edit_customer_id_CLI(customer, "surname");
+                this->edit_customer_id_CLI(handle, "surname");
                 break;
             case 3:
                 exit_menu = true;
@@ -686,7 +902,9 @@ Please choose an option below:
 1: Search contract by name
 2: Search contract by datetime
 3: Search contract by money
-4: Go back to previous menu
+4: Search contract by datetime and money
+5: List the largest contracts
+6: Go back to previous menu
 
 ===============================================================
 
@@ -705,6 +923,12 @@ Please choose an option below:
             this->search_contract_by_money_CLI(customer);
             break;
         case 4:
+            this->search_contract_by_datetime_and_money_CLI(customer);
+            break;
+        case 5:
+            this->search_top_contracts_by_money_CLI(customer);
+            break;
+        case 6:
             exit_menu = true;
             break;
     }
@@ -721,8 +945,8 @@ void CRM::search_contract_by_name_CLI(Customer* customer){
     vector<string> user_input_strings;
     string user_input_string;
     bool cancel_condition = false;
-    vector<Contract*> matching_contracts;
-    Contract* selected_contract;
+    vector<Contract> matching_contracts;
+    Contract selected_contract;
 
 
     ////////////////////////////////////////////////
@@ -735,8 +959,9 @@ void CRM::search_contract_by_name_CLI(Customer* customer){
     (this->logger)->logfile << " Done" << endl;
 
     // combining back the parsed strings into a single string in lowercase
-    for(string parsed_string: user_input_strings){
-        user_input_string += (to_lowercase(parsed_string) + " ");
+    for(const string& parsed_string: user_input_strings){
+        append_lowercase(parsed_string, user_input_string);
+        user_input_string += ' ';
     }
 
     trim_string(user_input_string);
@@ -745,14 +970,7 @@ void CRM::search_contract_by_name_CLI(Customer* customer){
     ////////////////////////////////////////////////
     // find matching contracts
 
-    for(Contract& contract: customer->get_contract_record().get_contract_record()){
-
-        if(to_lowercase(contract.get_name()).find(user_input_string) != string::npos){
-
-
-            matching_contracts.push_back(&contract);
-        }
-    }
+    matching_contracts = customer->get_contract_record().search_contracts_by_name(user_input_string);
 
     ////////////////////////////////////////////////
     // let user choose among matching contracts
@@ -761,7 +979,7 @@ void CRM::search_contract_by_name_CLI(Customer* customer){
     cout << endl << SEPARATOR_LINE << endl;
     (this->logger)->logfile << "Searching for contract by name process completed..." << endl << SEPARATOR_LINE << endl;
 
-    if(selected_contract == nullptr){
+    if(!(selected_contract.is_valid())){
 
         return;
     }
@@ -783,9 +1001,10 @@ void CRM::search_contract_by_datetime_CLI(Customer* customer){
     vector<string> user_input_strings;
     string start_datetime_string;
     string end_datetime_string;
+    int32_t start_days, end_days;
     bool cancel_condition = false;
-    vector<Contract*> matching_contracts;
-    Contract* selected_contract;
+    vector<Contract> matching_contracts;
+    Contract selected_contract;
 
     cout << initial_prompt << endl;
 
@@ -805,7 +1024,7 @@ void CRM::search_contract_by_datetime_CLI(Customer* customer){
     
 
     (this->logger)->logfile << "Asking the user to enter final datetime string...";
-    read_user_input(user_input_strings, end_datetime_prompt, this->logger, false, 1, true);
+    cancel_condition = read_user_input(user_input_strings, end_datetime_prompt, this->logger, false, 1, true);
     if(cancel_condition){
             return;
     }
@@ -813,14 +1032,14 @@ void CRM::search_contract_by_datetime_CLI(Customer* customer){
     end_datetime_string = user_input_strings[0];
 
 
-    ////////////////////////////////////////////////
-    // find matching contracts
-    for(Contract& contract: customer->get_contract_record().get_contract_record()){
+    // the bounds are parsed only once (the strings were already validated, so parsing cannot fail)
+    parse_datetime_string(start_datetime_string, start_days);
+    parse_datetime_string(end_datetime_string, end_days);
 
-        if((contract >= start_datetime_string) && (contract <= end_datetime_string)){
-            matching_contracts.push_back(&contract);
-        }
-    }
+
+    ////////////////////////////////////////////////
+    // find matching contracts through the record's datetime index
+    matching_contracts = customer->get_contract_record().search_contracts_by_datetime(start_days, end_days);
 
 
     ////////////////////////////////////////////////
@@ -833,7 +1052,7 @@ void CRM::search_contract_by_datetime_CLI(Customer* customer){
     cout << endl << SEPARATOR_LINE << endl;
 
 
-    if(selected_contract == nullptr){
+    if(!(selected_contract.is_valid())){
         return;
     }
     else{
@@ -843,20 +1062,20 @@ void CRM::search_contract_by_datetime_CLI(Customer* customer){
 
 }
 
-Contract* CRM::select_contract(vector<Contract*> matching_contracts){
+Contract CRM::select_contract(vector<Contract> matching_contracts){
 
     int user_choice=0;
 
     if(matching_contracts.size() == 0){
         cout << endl << endl << "No existing contract matches your query." << endl;
-        return nullptr;
+        return Contract();
     }
     else{
         cout << "The following contracts match your query." << endl;
         string prompt =  "Enter the corresponding number to select a specific contract.  Enter -1 to cancel the operation.";
-        for(int i = 0; i < matching_contracts.size(); i++){
+        for(size_t i = 0; i < matching_contracts.size(); i++){
             cout << i +1 << ") ";
-            matching_contracts[i]->print();
+            matching_contracts[i].print();
             cout << endl;
         }
 
@@ -864,10 +1083,10 @@ Contract* CRM::select_contract(vector<Contract*> matching_contracts){
         // handle CLI interactions to let the user choose among existing matches
 
         read_user_menu_choice(user_choice, matching_contracts.size(), prompt, this->logger, true);
-        if(user_choice == -1){ // cancel operation
+        if(user_choice < 1){ // -1 cancels the operation, 0 does not correspond to any contract
                      cout << endl << "Operation Cancelled." << endl << SEPARATOR_LINE  << endl;
                     (this->logger)->logfile << "Operation cancelled by the user" << endl << SEPARATOR_LINE << endl;
-                    return nullptr;
+                    return Contract();
         }
 
     }
@@ -878,6 +1097,143 @@ Contract* CRM::select_contract(vector<Contract*> matching_contracts){
 }
 
 
+vector<ContractMatch> CRM::search_contracts(const ContractQuery& query){
+
+    vector<ContractMatch> matches;
+    vector<Contract> matching_contracts;
+
+    // the name condition is resolved once against the global index of the contract names, rather than record by record
+    ContractQuery record_query = query;
+    vector<int8_t> name_ranks;
+    if(!(query.name_substring.empty())){
+        name_ranks = ContractRecord::names.rank_names(query.name_substring);
+        record_query.name_ranks = &name_ranks;
+    }
+
+    for(Customer& customer: this->customer_record){
+        matching_contracts.clear();
+        customer.get_contract_record().search_contracts(record_query, matching_contracts);
+        for(Contract contract: matching_contracts){
+            matches.push_back({&customer, contract});
+        }
+    }
+
+    // most relevant names first, see name_match_rank
+    if(!(name_ranks.empty())){
+        stable_sort(matches.begin(), matches.end(), [&](const ContractMatch& a, const ContractMatch& b){
+            return name_ranks[a.contract.get_record()->get_name_id(a.contract.get_position())] < name_ranks[b.contract.get_record()->get_name_id(b.contract.get_position())];
+        });
+    }
+    return matches;
+}
+
+
+void CRM::search_all_contracts_CLI(){
+
+    (this->logger)->logfile << "Searching contracts across all customers process started..." << endl;
+
+    string name_prompt = "Type a (sub)string which is contained in the contracts' names, or leave empty to accept any name. Type 'q' to cancel the operation.";
+    string datetime_filter_prompt = "Do you want to filter the contracts by datetime? Type 'y' for yes and 'n' for no.";
+    string start_datetime_prompt= "Enter a start date in the format " + date_format + " . Type 'q' to cancel the operation.";
+    string end_datetime_prompt= "Enter a final date in the format " + date_format + " . Type 'q' to cancel the operation.";
+    string money_filter_prompt = "Do you want to filter the contracts by money? Type 'y' for yes and 'n' for no.";
+    string lower_money_prompt= "Enter a lower bound for the amount of money (only positive numbers). Type 'q' to cancel the operation.";
+    string upper_money_prompt= "Enter an upper bound for the amount of money (only positive numbers). Type 'q' to cancel the operation.";
+
+    vector<string> user_input_strings;
+    bool cancel_condition = false;
+    ContractQuery query;
+    vector<ContractMatch> matches;
+    int user_choice;
+
+
+    ////////////////////////////////////////////////
+    // handle CLI Interaction
+
+    // name condition
+    (this->logger)->logfile << "Asking the user to enter the name (sub)string...";
+    cancel_condition = ask_user_input(user_input_strings, name_prompt);
+    if(cancel_condition){
+        cout << endl << "Operation Cancelled." << endl << SEPARATOR_LINE  << endl;
+        (this->logger)->logfile << "Operation cancelled by the user" << endl << SEPARATOR_LINE << endl;
+        return;
+    }
+    for(const string& parsed_string: user_input_strings){
+        query.name_substring += parsed_string;
+        query.name_substring += ' ';
+    }
+    trim_string(query.name_substring);
+    (this->logger)->logfile << " Done" << endl;
+
+    // datetime condition
+    if(read_user_answer(datetime_filter_prompt, this->logger)){
+        user_input_strings.clear();
+        cancel_condition = read_user_input(user_input_strings, start_datetime_prompt, this->logger, false, 1, true);
+        if(cancel_condition){
+            return;
+        }
+        parse_datetime_string(user_input_strings[0], query.start_days);
+
+        user_input_strings.clear();
+        cancel_condition = read_user_input(user_input_strings, end_datetime_prompt, this->logger, false, 1, true);
+        if(cancel_condition){
+            return;
+        }
+        parse_datetime_string(user_input_strings[0], query.end_days);
+    }
+
+    // money condition
+    if(read_user_answer(money_filter_prompt, this->logger)){
+        cancel_condition = read_user_input(query.lower_money, lower_money_prompt, this->logger, true);
+        if(cancel_condition){
+            return;
+        }
+        cancel_condition = read_user_input(query.upper_money, upper_money_prompt, this->logger, true);
+        if(cancel_condition){
+            return;
+        }
+    }
+
+
+    ////////////////////////////////////////////////
+    // find matching contracts
+
+    (this->logger)->logfile << "Searching contracts across all customers...";
+    matches = this->search_contracts(query);
+    (this->logger)->logfile << " Done. " << matches.size() << " matches found." << endl;
+
+    if(matches.size() == 0){
+        cout << endl << endl << "No existing contract matches your query." << endl << SEPARATOR_LINE << endl;
+        (this->logger)->logfile << "Searching contracts across all customers process completed." << endl << SEPARATOR_LINE << endl;
+        return;
+    }
+
+
+    ////////////////////////////////////////////////
+    // let the user choose among the matching contracts
+
+    cout << "The following contracts match your query." << endl;
+    for(size_t i = 0; i < matches.size(); i++){
+        cout << i+1 << ") Customer: " << matches[i].customer->get_name() << " " << matches[i].customer->get_surname() << endl;
+        matches[i].contract.print();
+        cout << endl;
+    }
+
+    string prompt = "Enter the corresponding number to select a specific contract.  Enter -1 to cancel the operation.";
+    read_user_menu_choice(user_choice, matches.size(), prompt, this->logger, true);
+
+    cout << endl << SEPARATOR_LINE << endl;
+    (this->logger)->logfile << "Searching contracts across all customers process completed." << endl << SEPARATOR_LINE << endl;
+
+    if(user_choice < 1){ // -1 cancels the operation, 0 does not correspond to any contract
+        cout << endl << "Operation Cancelled." << endl << SEPARATOR_LINE  << endl;
+        (this->logger)->logfile << "Operation cancelled by the user" << endl << SEPARATOR_LINE << endl;
+        return;
+    }
+    this->edit_contract_menu(matches[user_choice-1].customer, matches[user_choice-1].contract);
+}
+
+
 void CRM::search_contract_by_money_CLI(Customer* customer){
 
     (this->logger)->logfile << "Searching for contract by money process started...";
@@ -890,8 +1246,8 @@ void CRM::search_contract_by_money_CLI(Customer* customer){
     float lower_money, upper_money;
 
     bool cancel_condition = false;
-    vector<Contract*> matching_contracts;
-    Contract* selected_contract;
+    vector<Contract> matching_contracts;
+    Contract selected_contract;
 
       ////////////////////////////////////////////////
     // handle CLI interaction
@@ -914,20 +1270,15 @@ void CRM::search_contract_by_money_CLI(Customer* customer){
 
 
     ////////////////////////////////////////////////
-    // find matching contracts
+    // find matching contracts through the record's money index
 
-    for(Contract& contract: customer->get_contract_record().get_contract_record()){
-
-        if((contract.get_money() >= lower_money) && (contract.get_money() <= upper_money)){
-            matching_contracts.push_back(&contract);
-        }
-    }
+    matching_contracts = customer->get_contract_record().search_contracts_by_money(lower_money, upper_money);
 
     ////////////////////////////////////////////////
     // let the user choose among the potentialòy matching contracts
 
     selected_contract = select_contract(matching_contracts);
-    if(selected_contract == nullptr){
+    if(!(selected_contract.is_valid())){
         return;
     }
     else{
@@ -940,46 +1291,163 @@ void CRM::search_contract_by_money_CLI(Customer* customer){
 }
 
 
-void CRM::edit_contract_menu(Customer* customer, Contract* contract){
-(this->logger)->logfile << "Opening Edit Contract Menu" << endl << SEPARATOR_LINE << endl;
+void CRM::search_contract_by_datetime_and_money_CLI(Customer* customer){
 
-    int user_choice;
-    bool exit_menu = false;
-    string prompt = format("Enter your choice (1–{}): ", this->edit_contract_menu_possible_actions);
+    (this->logger)->logfile << "Searching for contract by datetime and money process started..." << endl;
 
-    string menu_message = R"(
-==================== Edit Contract Menu ====================
+    string initial_prompt = "You need to specify a time period and a money range within which the contract falls.";
+    string start_datetime_prompt= "Enter a start date in the format " + date_format + " . Type 'q' to cancel the operation.";
+    string end_datetime_prompt= "Enter a final date in the format " + date_format + " . Type 'q' to cancel the operation.";
+    string lower_money_prompt= "Enter a lower bound for the amount of money (only positive numbers). Type 'q' to cancel the operation.";
+    string upper_money_prompt= "Enter an upper bound for the amount of money (only positive numbers). Type 'q' to cancel the operation.";
 
-Please choose an option below:
+    vector<string> user_input_strings;
+    bool cancel_condition = false;
+    ContractQuery query;
+    vector<Contract> matching_contracts;
+    Contract selected_contract;
 
-1: Edit contract's name
-2: Edit contract's datetime
-3: Edit contract's money
-4: Delete contract
-5: Go back to the previous menu
+    cout << initial_prompt << endl;
 
-===============================================================
+    ////////////////////////////////////////////////
+    // handle CLI Interaction
 
-)";
+    (this->logger)->logfile << "Asking the user to enter start datetime string..." << endl;
+    cancel_condition = read_user_input(user_input_strings, start_datetime_prompt, this->logger, false, 1, true);
+    if(cancel_condition){
+            return;
+    }
+    parse_datetime_string(user_input_strings[0], query.start_days);
+    user_input_strings.clear();
 
-    while(!(exit_menu)){
-        
+    (this->logger)->logfile << "Asking the user to enter final datetime string..." << endl;
+    cancel_condition = read_user_input(user_input_strings, end_datetime_prompt, this->logger, false, 1, true);
+    if(cancel_condition){
+            return;
+    }
+    parse_datetime_string(user_input_strings[0], query.end_days);
+
+    (this->logger)->logfile << "Asking the user to enter a positive number...";
+    cancel_condition = read_user_input(query.lower_money, lower_money_prompt, this->logger, true);
+    if(cancel_condition){
+            return;
+    }
+    (this->logger)->logfile << " Done" << endl;
+
+    (this->logger)->logfile << "Asking the user to enter a positive number...";
+    cancel_condition = read_user_input(query.upper_money, upper_money_prompt, this->logger, true);
+    if(cancel_condition){
+            return;
+    }
+    (this->logger)->logfile << " Done" << endl;
+
+
+    ////////////////////////////////////////////////
+    // find matching contracts, with the combined filter over the record's columns
+
+    customer->get_contract_record().search_contracts(query, matching_contracts);
+
+    ////////////////////////////////////////////////
+    // let the user choose among the matching contracts
+
+    selected_contract = select_contract(matching_contracts);
+
+    cout << endl << SEPARATOR_LINE << endl;
+    (this->logger)->logfile << "Searching for contract by datetime and money process completed." << endl << SEPARATOR_LINE << endl;
+
+    if(selected_contract.is_valid()){
+        this->edit_contract_menu(customer, selected_contract);
+    }
+}
+
+
+void CRM::search_top_contracts_by_money_CLI(Customer* customer){
+
+    (this->logger)->logfile << "Listing the largest contracts process started..." << endl;
+
+    int number_of_contracts = customer->get_contract_record().size();
+    int user_choice;
+    vector<Contract> largest_contracts;
+    Contract selected_contract;
+
+    if(number_of_contracts == 0){
+        cout << endl << "No contracts registered for this costumer yet." << endl;
+        (this->logger)->logfile << "No contracts to list." << endl << SEPARATOR_LINE << endl;
+        return;
+    }
+
+    ////////////////////////////////////////////////
+    // handle CLI interaction
+
+    string prompt = format("Enter how many of the largest contracts to list (1–{}). Insert -1 to cancel the operation.", number_of_contracts);
+    (this->logger)->logfile << "Asking the user to enter the number of contracts...";
+    read_user_menu_choice(user_choice, number_of_contracts, prompt, this->logger, true);
+    if(user_choice == -1){
+        cout << endl << "Operation Cancelled." << endl << SEPARATOR_LINE  << endl;
+        (this->logger)->logfile << "Operation cancelled by the user" << endl << SEPARATOR_LINE << endl;
+        return;
+    }
+    (this->logger)->logfile << " Done" << endl;
+
+    ////////////////////////////////////////////////
+    // retrieve the largest contracts through the record's money index and let the user choose among them
+
+    largest_contracts = customer->get_contract_record().top_contracts_by_money(user_choice);
+    selected_contract = select_contract(largest_contracts);
+
+    cout << endl << SEPARATOR_LINE << endl;
+    (this->logger)->logfile << "Listing the largest contracts process completed." << endl << SEPARATOR_LINE << endl;
+
+    if(selected_contract.is_valid()){
+        this->edit_contract_menu(customer, selected_contract);
+    }
+}
+
+
+void CRM::edit_contract_menu(Customer* customer, Contract contract){
+(this->logger)->logfile << "Opening Edit Contract Menu" << endl << SEPARATOR_LINE << endl;
+
+    int user_choice;
+    bool exit_menu = false;
+    string prompt = format("Enter your choice (1–{}): ", this->edit_contract_menu_possible_actions);
+
+    string menu_message = R"(
+==================== Edit Contract Menu ====================
+
+Please choose an option below:
+
+1: Edit contract's name
+2: Edit contract's datetime
+3: Edit contract's money
+4: Delete contract
+5: Go back to the previous menu
+
+===============================================================
+
+)";
+
+    while(!(exit_menu)){
+        
+        // the contract may no longer exist
+        if(!(contract.is_valid())){
+            break;
+        }
         cout << menu_message;
         read_user_menu_choice(user_choice, this->edit_contract_menu_possible_actions, prompt, this->logger);
     
         switch(user_choice){
                 case 1:
-                    this->edit_contract_name_CLI(contract);
+                    this->edit_contract_name_CLI(customer, contract);
                     break;
                 case 2:
-                    this->edit_contract_datetime_CLI(contract);
+                    this->edit_contract_datetime_CLI(customer, contract);
                     break;
                 case 3:
-                    this->edit_contract_money_CLI(contract);
+                    this->edit_contract_money_CLI(customer, contract);
                     break;
                 case 4:
                     (this->logger)->logfile << "Deleting contract...";
-                    customer->get_contract_record().delete_contract(contract);
+                    this->delete_contract(customer, contract);
                     exit_menu = true;
                     (this->logger)->logfile << " Done";
                     break;
@@ -995,7 +1463,7 @@ Please choose an option below:
 
 
 
-void CRM::edit_contract_name_CLI(Contract* contract){
+void CRM::edit_contract_name_CLI(Customer* customer, Contract contract){
 
     (this->logger)->logfile << "Edit contract name process started..." << endl;
 
@@ -1018,14 +1486,19 @@ void CRM::edit_contract_name_CLI(Contract* contract){
     (this->logger)->logfile << "User input string read." << endl;
 
     // combining back the parsed strings into a single string
-    for(string input_string: user_input_strings){
-        new_name += (input_string + " ");
+    for(const string& input_string: user_input_strings){
+        new_name += input_string;
+        new_name += ' ';
     }
 
     ////////////////////////////////////////////////
     // edit contract name
     (this->logger)->logfile << "Setting new contract name..." << endl;
-    contract->set_name(new_name);
+    if(!(this->set_contract_name(customer, contract, new_name))){
+        cout << "A contract named " << new_name << " already exists." << endl;
+        (this->logger)->logfile << "Editing contract name not executed due to existing duplicate" << endl << SEPARATOR_LINE << endl;
+        return;
+    }
     (this->logger)->logfile << " Done." << endl;
 
     (this->logger)->logfile << "Edit contract name process completed." << endl << SEPARATOR_LINE << endl;
@@ -1034,7 +1507,7 @@ void CRM::edit_contract_name_CLI(Contract* contract){
 
 
 
-void CRM::edit_contract_datetime_CLI(Contract* contract){
+void CRM::edit_contract_datetime_CLI(Customer* customer, Contract contract){
 
     (this->logger)->logfile << "Edit contract datetime process started..." << endl;
 
@@ -1060,7 +1533,7 @@ void CRM::edit_contract_datetime_CLI(Contract* contract){
     ////////////////////////////////////////////////
     // edit contract datetime
     (this->logger)->logfile << "Setting new contract datetime...";
-    contract->set_datetime(new_datetime);
+    this->set_contract_datetime(customer, contract, new_datetime);
     (this->logger)->logfile << " Done." << endl;
 
     (this->logger)->logfile << "Edit contract datetime process completed." << endl << SEPARATOR_LINE << endl;
@@ -1069,7 +1542,7 @@ void CRM::edit_contract_datetime_CLI(Contract* contract){
 
 
 
-void CRM::edit_contract_money_CLI(Contract* contract){
+void CRM::edit_contract_money_CLI(Customer* customer, Contract contract){
 
     (this->logger)->logfile << "Edit contract money process started..." << endl;
 
@@ -1091,7 +1564,7 @@ void CRM::edit_contract_money_CLI(Contract* contract){
     ////////////////////////////////////////////////
     // edit contract money
     (this->logger)->logfile << "Setting new contract money..." << endl;
-    contract->set_money(new_money);
+    this->set_contract_money(customer, contract, new_money);
     (this->logger)->logfile << " Done." << endl;
 
     (this->logger)->logfile << "Edit contract money process completed." << endl << SEPARATOR_LINE << endl;
@@ -1105,7 +1578,7 @@ void CRM::edit_contract_money_CLI(Contract* contract){
 
 void CRM::load_CLI(){
     (this->logger)->logfile << "Loading data from file process started..." << endl;
-    string prompt = "Type the path (relative or absolute) for the file where to load the data from. This must be a single string with no whitespaces. Type 'q' to cancel the operation.";
+    string prompt = "Type the path (relative or absolute) for the file where to load the data from, or for a directory whose .json files are all loaded. This must be a single string with no whitespaces. Type 'q' to cancel the operation.";
     bool cancel_condition = false;
     
     string file_path;
@@ -1127,22 +1600,25 @@ void CRM::load_CLI(){
 
         file_path = user_input_strings[0];
 
-        (this->logger)->logfile << "Validating user input file path...";
          if(!(validate_path(file_path))){
             cout << "The path entered is not a valid a path. Try again." << endl;
-            (this->logger)->logfile << " Not valid.";
+            LOG_TRACE(this->logger, "Validating user input file path {}... Not valid.", file_path);
             continue;
         }
-        (this->logger)->logfile << " Validated." << endl;
+        LOG_TRACE(this->logger, "Validating user input file path {}... Validated.", file_path);
         break;
     }
     
     ////////////////////////////////////////////////
     // load data
     (this->logger)->logfile << "Deserializing data process started..." << endl;
-    json j;
-    this->load(file_path, j);
+    vector<CustomerConflict> conflicts = this->load_data(file_path);
     (this->logger)->logfile << "Deserializing data process completed" << endl;
+
+    this->resolve_conflicts_CLI(conflicts);
+
+    // loaded data is persisted in the data store as a whole, rather than customer by customer through the journal
+    this->compact();
     (this->logger)->logfile << "Loading data from file process completed." << endl << SEPARATOR_LINE << endl;
 
 
@@ -1153,7 +1629,7 @@ void CRM::save_CLI(){
     (this->logger)->logfile << "Saving data to file process started..." << endl;
     
 
-    string prompt = "Type the path (relative or absolute) for the file where to save the data. This must be a single string with no whitespaces. Type 'q' to cancel the operation.";
+    string prompt = "Type the path (relative or absolute) for the file where to save the data. This must be a single string with no whitespaces. Paths ending in " + snapshot_extension + " are saved as binary snapshots, any other as json. Type 'q' to cancel the operation.";
     bool cancel_condition = false;
     
     string file_path;
@@ -1175,13 +1651,12 @@ void CRM::save_CLI(){
 
         file_path = user_input_strings[0];
 
-        (this->logger)->logfile << "Validating user input file path...";
          if(!(validate_path(file_path))){
             cout << "The path entered is not a valid a path. Try again." << endl;
-            (this->logger)->logfile << " Not valid.";
+            LOG_TRACE(this->logger, "Validating user input file path {}... Not valid.", file_path);
             continue;
         }
-        (this->logger)->logfile << " Validated." << endl;
+        LOG_TRACE(this->logger, "Validating user input file path {}... Validated.", file_path);
         break;
     }
 
@@ -1189,12 +1664,8 @@ void CRM::save_CLI(){
      ////////////////////////////////////////////////
     // dump data
 
-    (this->logger)->logfile << "Serializing data...";
-    json j = *this;
-    (this->logger)->logfile << " Done" << endl;
-
-     (this->logger)->logfile << "Writing data to file...";
-    this->save(file_path, j);
+    (this->logger)->logfile << "Writing data to file...";
+    this->save_data(file_path);
     (this->logger)->logfile << " Done" << endl;
 
     (this->logger)->logfile << "Saving data to file process completed." << endl << SEPARATOR_LINE << endl;
@@ -1202,67 +1673,903 @@ void CRM::save_CLI(){
 }
 
 
-void CRM::save(string file_path, json& j){
-    ofstream outFile(file_path);
+void CRM::save(string file_path, bool pretty){
+    // the file is written in large chunks, while the customers are serialized one at a time
+    vector<char> output_buffer(1 << 20);
+    ofstream outFile;
+    outFile.rdbuf()->pubsetbuf(output_buffer.data(), output_buffer.size());
+    outFile.open(file_path);
     if (!outFile) {
         throw std::runtime_error("Could not open file: " + file_path);
         (this->logger)->logfile << "Could not open file: " << file_path << endl;
     }
 
-    outFile << j.dump(4);  // 4 spaces for indent
+    JsonWriter writer(outFile, pretty, 4);  // 4 spaces for indent
+    write_json(writer, *this);
     outFile.close();
     return;
 }
 
 
 
-void CRM::load(string file_path, json& j){
+/**
+ * @class CustomerSaxHandler
+ * @brief Receives the tokens of a json data file from the nlohmann SAX parser and builds the customers and their contracts as the tokens arrive.
+ *
+ * Each customer is handed over as a StagedCustomer as soon as its object is closed, so that only one customer at a time is held by the handler.
+ * The names of the customers and contracts are copied into a StringArena given by the caller, instead of one string allocated per value.
+ * The handler touches no state shared with the CRM, so that several files can be parsed concurrently.
+ * Keys may appear in any order and unknown keys are skipped, as with the from_json functions.
+ */
+class CustomerSaxHandler : public nlohmann::json_sax<json>
+{
+    private:
+        // the objects and arrays the parser is currently in
+        enum class Context { root, customer_array, customer, contract_record, contract_array, contract, skipped };
+
+        // receives the names, and each customer once it is complete
+        StringArena& strings;
+        function<void(StagedCustomer&)> on_customer;
+        vector<Context> contexts;
+        std::string current_key;
+
+        // fields of the customer being read
+        StagedCustomer customer;
+        bool has_name, has_surname, has_contract_record;
+        bool has_customer_record = false;
+
+        // fields of the contract being read
+        string_view contract_name;
+        std::string contract_datetime;
+        float contract_money;
+        bool has_contract_name, has_contract_money, has_contract_datetime;
+
+        Context context() const{
+            return this->contexts.empty() ? Context::skipped : this->contexts.back();
+        }
+
+        [[noreturn]] static void throw_format_error(const std::string& message){
+            throw runtime_error("\nInvalid data file: " + message + "\n");
+        }
+
+        // stores a string value of the customer or contract being read
+        bool store_string(std::string& value){
+            if(this->context() == Context::customer){
+                if(this->current_key == "name"){
+                    this->customer.name = this->strings.store(value);
+                    this->has_name = true;
+                }
+                else if(this->current_key == "surname"){
+                    this->customer.surname = this->strings.store(value);
+                    this->has_surname = true;
+                }
+            }
+            else if(this->context() == Context::contract){
+                if(this->current_key == "name"){
+                    this->contract_name = this->strings.store(value);
+                    this->has_contract_name = true;
+                }
+                else if(this->current_key == "datetime"){
+                    // copied rather than moved, so that both the parser and the handler keep their buffers
+                    this->contract_datetime = value;
+                    this->has_contract_datetime = true;
+                }
+            }
+            return true;
+        }
+
+        // stores a numeric value of the contract being read
+        bool store_number(double value){
+            if((this->context() == Context::contract) && (this->current_key == "money")){
+                // the amount is read as an integer, as in from_json
+                this->contract_money = int(value);
+                this->has_contract_money = true;
+            }
+            return true;
+        }
+
+        void end_customer(){
+            if(!(this->has_name && this->has_surname && this->has_contract_record)){
+                throw_format_error("a customer lacks its name, surname or contract record");
+            }
+            this->on_customer(this->customer);
+            // the contracts vector keeps its capacity when the customer has not been moved away
+            this->customer.contracts.clear();
+        }
+
+        void end_contract(){
+            if(!(this->has_contract_name && this->has_contract_money && this->has_contract_datetime)){
+                throw_format_error("a contract of customer " + std::string(this->customer.name) + " " + std::string(this->customer.surname) + " lacks its name, money or datetime");
+            }
+            int32_t datetime;
+            if(!(parse_datetime_string(this->contract_datetime, datetime))){
+                throw_format_error("contract " + std::string(this->contract_name) + " of customer " + std::string(this->customer.name) + " " + std::string(this->customer.surname) + " has an invalid datetime " + this->contract_datetime);
+            }
+            this->customer.contracts.push_back({this->contract_name, this->contract_money, datetime});
+        }
+
+    public:
+        CustomerSaxHandler(StringArena& _strings, function<void(StagedCustomer&)> _on_customer)
+            : strings(_strings), on_customer(move(_on_customer))
+        {}
+
+        bool start_object(size_t) override{
+            Context next = Context::skipped;
+            if(this->contexts.empty()){
+                next = Context::root;
+            }
+            else if(this->context() == Context::customer_array){
+                next = Context::customer;
+                this->has_name = this->has_surname = this->has_contract_record = false;
+            }
+            else if((this->context() == Context::customer) && (this->current_key == "contract_record")){
+                next = Context::contract_record;
+                this->has_contract_record = true;
+            }
+            else if(this->context() == Context::contract_array){
+                next = Context::contract;
+                this->has_contract_name = this->has_contract_money = this->has_contract_datetime = false;
+            }
+            this->contexts.push_back(next);
+            return true;
+        }
+
+        bool end_object() override{
+            Context ended = this->context();
+            this->contexts.pop_back();
+            if(ended == Context::customer){
+                this->end_customer();
+            }
+            else if(ended == Context::contract){
+                this->end_contract();
+            }
+            else if((ended == Context::root) && !(this->has_customer_record)){
+                throw_format_error("the customer_record array is missing");
+            }
+            return true;
+        }
+
+        bool start_array(size_t) override{
+            Context next = Context::skipped;
+            if((this->context() == Context::root) && (this->current_key == "customer_record")){
+                next = Context::customer_array;
+                this->has_customer_record = true;
+            }
+            else if((this->context() == Context::contract_record) && (this->current_key == "contract_record")){
+                next = Context::contract_array;
+            }
+            this->contexts.push_back(next);
+            return true;
+        }
+
+        bool end_array() override{
+            this->contexts.pop_back();
+            return true;
+        }
+
+        bool key(std::string& value) override{
+            this->current_key = value;
+            return true;
+        }
+
+        bool string(std::string& value) override{
+            return this->store_string(value);
+        }
+
+        bool number_integer(number_integer_t value) override{
+            return this->store_number(double(value));
+        }
+
+        bool number_unsigned(number_unsigned_t value) override{
+            return this->store_number(double(value));
+        }
+
+        bool number_float(number_float_t value, const std::string&) override{
+            return this->store_number(value);
+        }
+
+        bool null() override{
+            return true;
+        }
+
+        bool boolean(bool) override{
+            return true;
+        }
+
+        bool binary(binary_t&) override{
+            return true;
+        }
+
+        bool parse_error(size_t, const std::string&, const nlohmann::detail::exception& ex) override{
+            throw_format_error(ex.what());
+        }
+};
+
+
+void CRM::save_data(const string& file_path, bool pretty){
+
+    // files with the snapshot extension are written as binary snapshots, any other file as json
+    if(filesystem::path(file_path).extension() == snapshot_extension){
+        this->save_snapshot(file_path);
+    }
+    else{
+        this->save(file_path, pretty);
+    }
+}
+
+
+vector<CustomerConflict> CRM::load_data(const string& path){
+
+    // snapshots are told apart from json files by their first bytes, and the json files of a directory are parsed in parallel.
+    // A single json file is streamed into the customer record instead, as staging it whole would hold its data twice in memory
+    if(!(filesystem::is_directory(path)) && is_snapshot_file(path)){
+        return this->load_snapshot(path);
+    }
+    vector<string> file_paths = CRM::list_data_files(path);
+    if(file_paths.size() == 1){
+        return this->load(file_paths[0]);
+    }
+    return this->load_files(file_paths);
+}
+
+
+vector<CustomerConflict> CRM::load(string file_path){
     ifstream input_file(file_path);
     if (!input_file) {
         throw std::runtime_error("Could not load data from file: " + file_path);
         (this->logger)->logfile << "Could not load data from file: " << file_path << endl;
 
     }
-    input_file >> j;
-    from_json(j, *this);
+
+    // each customer is merged as soon as it has been read, then its strings are dropped from the arena
+    vector<CustomerConflict> conflicts;
+    StringArena strings;
+    CustomerSaxHandler handler(strings, [&](StagedCustomer& customer){
+        this->merge_staged_customer(customer, conflicts);
+        strings.clear();
+    });
+    json::sax_parse(input_file, &handler);
+    return conflicts;
 }
 
 
+vector<string> CRM::list_data_files(const string& path){
 
-void to_json(json& j, const CRM& crm) {
-    j = json{{"customer_record", crm.customer_record}};
+    if(!(filesystem::is_directory(path))){
+        return {path};
+    }
+
+    vector<string> file_paths;
+    for(const filesystem::directory_entry& entry: filesystem::directory_iterator(path)){
+        if(entry.is_regular_file() && (entry.path().extension() == ".json")){
+            file_paths.push_back(entry.path().string());
+        }
+    }
+    sort(file_paths.begin(), file_paths.end());
+    return file_paths;
 }
 
-void from_json(const json& j, CRM& crm) {
 
-    // first load the data in a temporary CRM object
-    CRM temp_crm;
-    j.at("customer_record").get_to(temp_crm.customer_record);
-    Customer* customer_duplicate = nullptr;
-    vector<string> id, user_inpus;
-    string name, surname, answer;
-    string prompt; 
+vector<CustomerConflict> CRM::load_files(const vector<string>& file_paths, size_t thread_count){
 
-    // add customers from the temporary CRM object one by one manually, checking if there are duplicates with the currently loaded data
-    for(Customer& customer: temp_crm.customer_record){
-        name = customer.get_name();
-        surname = customer.get_surname();
-        prompt = string("Customer ") + name + string(" ") + surname + string(" already exists. Do you want to overwrite it? Type 'y' for yes and 'n' for no." );
-        id = {name, surname};
+    if(thread_count == 0){
+        thread_count = max(1u, thread::hardware_concurrency());
+    }
+    thread_count = min(thread_count, file_paths.size());
+    (this->logger)->logfile << "Loading " << file_paths.size() << " files with " << thread_count << " threads..." << endl;
+
+    // one staging area per file, filled by whichever thread parses the file
+    vector<promise<StagedFile>> staging_areas(file_paths.size());
+    vector<future<StagedFile>> staged_files;
+    for(promise<StagedFile>& staging_area: staging_areas){
+        staged_files.push_back(staging_area.get_future());
+    }
 
-        (*(crm.logger)).logfile << "Searching for potential duplicates of customer " << name << " " << surname <<  "...";
-        customer_duplicate = crm.select_customer(id, false); // this checks that there is not already an existing customer with the same name and surname
-        (*(crm.logger)).logfile << " Done." << endl;
+    // the threads take the files in order, so that the first files are ready first. A staged file holds all the data of the file, so the threads
+    // only run a few files ahead of the merge: at most staged_window files are staged or being parsed at any time, the one being merged included
+    const size_t staged_window = thread_count + 1;
+    size_t next_file = 0;
+    size_t merged_files = 0;
+    mutex window_mutex;
+    condition_variable window_moved;
+    auto claim_file = [&](){
+        unique_lock<mutex> lock(window_mutex);
+        window_moved.wait(lock, [&](){ return (next_file >= file_paths.size()) || (next_file < merged_files + staged_window); });
+        return (next_file < file_paths.size()) ? next_file++ : file_paths.size();
+    };
+
+    vector<thread> parsers;
+    for(size_t i = 0; i < thread_count; i++){
+        parsers.emplace_back([&](){
+            for(size_t file = claim_file(); file < file_paths.size(); file = claim_file()){
+                try{
+                    ifstream input_file(file_paths[file]);
+                    if (!input_file) {
+                        throw std::runtime_error("Could not load data from file: " + file_paths[file]);
+                    }
+                    StagedFile staged;
+                    CustomerSaxHandler handler(staged.strings, [&](StagedCustomer& customer){ staged.customers.push_back(move(customer)); });
+                    json::sax_parse(input_file, &handler);
+                    staging_areas[file].set_value(move(staged));
+                }
+                catch(...){
+                    staging_areas[file].set_exception(current_exception());
+                }
+            }
+        });
+    }
 
-        if(customer_duplicate == nullptr) // no duplicate is found, free to proceed with adding the new customer
-        {   
-            crm.customer_record.push_back(customer); 
+    // the staged customers are merged in the order of the files while the following files are still being parsed.
+    // After an error the remaining files are not parsed, and the data of the files before it stays loaded
+    vector<CustomerConflict> conflicts;
+    exception_ptr error = nullptr;
+    size_t claimed_files = file_paths.size();
+    for(size_t file = 0; file < claimed_files; file++){
+        try{
+            // the strings of the file are freed at once when the staged file goes out of scope
+            StagedFile staged = staged_files[file].get();
+            if(error == nullptr){
+                (this->logger)->logfile << "Merging " << staged.customers.size() << " customers from " << file_paths[file] << "..." << endl;
+                this->customer_record.reserve(this->customer_record.size() + staged.customers.size());
+                for(StagedCustomer& customer: staged.customers){
+                    this->merge_staged_customer(customer, conflicts);
+                }
+            }
         }
-        else{    // if a duplicate is found, let the user decide if to overwrite ot not
-            if(read_user_answer(prompt, crm.logger)){
-                crm.delete_customer(customer_duplicate);
-                crm.customer_record.push_back(customer); 
+        catch(...){
+            if(error == nullptr){
+                error = current_exception();
+                // the files not claimed by a thread yet are never parsed, so their staging areas are never filled: only the claimed ones are waited for
+                lock_guard<mutex> lock(window_mutex);
+                claimed_files = next_file;
+                next_file = file_paths.size();
+                (this->logger)->logfile << "Loading " << file_paths[file] << " failed, the following files are skipped" << endl;
             }
         }
+
+        {
+            lock_guard<mutex> lock(window_mutex);
+            merged_files = file + 1;
+        }
+        window_moved.notify_all();
+    }
+
+    for(thread& parser: parsers){
+        parser.join();
+    }
+    if(error != nullptr){
+        rethrow_exception(error);
+    }
+
+    (this->logger)->logfile << "Loading files completed. " << conflicts.size() << " conflicts found." << endl;
+    return conflicts;
+}
+
+
+// helpers for writing the sections of a snapshot
+
+template<typename T>
+static void write_snapshot_value(ostream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static void write_snapshot_array(ostream& out, const vector<T>& values)
+{
+    out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+// pads the file with zeros up to the start of the next section
+static void write_snapshot_padding(ostream& out, uint64_t section_offset)
+{
+    for(uint64_t position = out.tellp(); position < section_offset; position++){
+        out.put('\0');
+    }
+}
+
+
+void CRM::save_snapshot(string file_path, uint64_t generation){
+
+    NameTable& names = ContractRecord::names;
+
+    ////////////////////////////////////////////////
+    // compute the size and position of every section
+
+    SnapshotHeader header = {};
+    copy(snapshot_magic, snapshot_magic + sizeof(snapshot_magic), header.magic);
+    header.version = snapshot_version;
+    header.header_size = sizeof(SnapshotHeader);
+    header.generation = generation;
+    header.customer_count = this->customer_record.size();
+    header.contract_name_count = names.size();
+    header.string_count = names.size() + 2 * this->customer_record.size();
+
+    for(uint32_t id = 0; id < names.size(); id++){
+        header.string_bytes += names.get_name(id).size();
     }
-}
\ No newline at end of file
+    for(Customer& customer: this->customer_record){
+        // the contracts are written by position, which requires the records free of tombstones
+        customer.get_contract_record().compact();
+        header.string_bytes += customer.get_name().size() + customer.get_surname().size();
+        header.contract_count += customer.get_contract_record().size();
+    }
+
+    header.string_offsets_offset = snapshot_align(sizeof(SnapshotHeader));
+    header.string_data_offset = snapshot_align(header.string_offsets_offset + (header.string_count + 1) * sizeof(uint64_t));
+    header.customers_offset = snapshot_align(header.string_data_offset + header.string_bytes);
+    header.name_column_offset = snapshot_align(header.customers_offset + header.customer_count * sizeof(SnapshotCustomer));
+    header.money_column_offset = snapshot_align(header.name_column_offset + header.contract_count * sizeof(uint32_t));
+    header.datetime_column_offset = snapshot_align(header.money_column_offset + header.contract_count * sizeof(float));
+    header.datetime_order_offset = snapshot_align(header.datetime_column_offset + header.contract_count * sizeof(int32_t));
+    header.money_order_offset = snapshot_align(header.datetime_order_offset + header.contract_count * sizeof(uint32_t));
+    header.file_size = header.money_order_offset + header.contract_count * sizeof(uint32_t);
+
+    ////////////////////////////////////////////////
+    // write the sections one after the other, in large chunks
+
+    vector<char> output_buffer(1 << 20);
+    ofstream outFile;
+    outFile.rdbuf()->pubsetbuf(output_buffer.data(), output_buffer.size());
+    outFile.open(file_path, ios::binary);
+    if (!outFile) {
+        (this->logger)->logfile << "Could not open file: " << file_path << endl;
+        throw std::runtime_error("Could not open file: " + file_path);
+    }
+
+    (this->logger)->logfile << "Writing snapshot of " << header.customer_count << " customers and " << header.contract_count << " contracts...";
+    write_snapshot_value(outFile, header);
+
+    write_snapshot_padding(outFile, header.string_offsets_offset);
+    uint64_t string_offset = 0;
+    write_snapshot_value(outFile, string_offset);
+    for(uint32_t id = 0; id < names.size(); id++){
+        string_offset += names.get_name(id).size();
+        write_snapshot_value(outFile, string_offset);
+    }
+    for(Customer& customer: this->customer_record){
+        string_offset += customer.get_name().size();
+        write_snapshot_value(outFile, string_offset);
+        string_offset += customer.get_surname().size();
+        write_snapshot_value(outFile, string_offset);
+    }
+
+    write_snapshot_padding(outFile, header.string_data_offset);
+    for(uint32_t id = 0; id < names.size(); id++){
+        outFile << names.get_name(id);
+    }
+    for(Customer& customer: this->customer_record){
+        outFile << customer.get_name() << customer.get_surname();
+    }
+
+    write_snapshot_padding(outFile, header.customers_offset);
+    uint64_t first_contract = 0;
+    uint32_t customer_string = header.contract_name_count;
+    for(Customer& customer: this->customer_record){
+        SnapshotCustomer entry = {};
+        entry.name_id = customer_string++;
+        entry.surname_id = customer_string++;
+        entry.first_contract = first_contract;
+        entry.contract_count = customer.get_contract_record().size();
+        write_snapshot_value(outFile, entry);
+        first_contract += entry.contract_count;
+    }
+
+    // each column holds the contracts of all the customers, in the order of the customer table
+    write_snapshot_padding(outFile, header.name_column_offset);
+    for(Customer& customer: this->customer_record){
+        ContractRecord& contract_record = customer.get_contract_record();
+        for(size_t i = 0; i < contract_record.size(); i++){
+            write_snapshot_value(outFile, contract_record.get_name_id(i));
+        }
+    }
+
+    write_snapshot_padding(outFile, header.money_column_offset);
+    for(Customer& customer: this->customer_record){
+        ContractRecord& contract_record = customer.get_contract_record();
+        for(size_t i = 0; i < contract_record.size(); i++){
+            write_snapshot_value(outFile, contract_record.get_money(i));
+        }
+    }
+
+    write_snapshot_padding(outFile, header.datetime_column_offset);
+    for(Customer& customer: this->customer_record){
+        ContractRecord& contract_record = customer.get_contract_record();
+        for(size_t i = 0; i < contract_record.size(); i++){
+            write_snapshot_value(outFile, contract_record.get_datetime(i));
+        }
+    }
+
+    vector<uint32_t> datetime_order;
+    vector<uint32_t> money_order;
+    write_snapshot_padding(outFile, header.datetime_order_offset);
+    for(Customer& customer: this->customer_record){
+        customer.get_contract_record().get_sorted_positions(datetime_order, money_order);
+        write_snapshot_array(outFile, datetime_order);
+    }
+
+    write_snapshot_padding(outFile, header.money_order_offset);
+    for(Customer& customer: this->customer_record){
+        customer.get_contract_record().get_sorted_positions(datetime_order, money_order);
+        write_snapshot_array(outFile, money_order);
+    }
+
+    outFile.close();
+    if(!outFile){
+        (this->logger)->logfile << endl << "Could not write file: " << file_path << endl;
+        throw std::runtime_error("Could not write file: " + file_path);
+    }
+    (this->logger)->logfile << " Done" << endl;
+}
+
+
+// checks that every element of a column of a snapshot is below a bound, so that the ids and positions it holds can be used without further checks
+static void check_snapshot_column(const uint32_t* column, uint64_t count, uint64_t bound)
+{
+    uint32_t largest = 0;
+    for(uint64_t i = 0; i < count; i++){
+        largest = max(largest, column[i]);
+    }
+    if((count > 0) && (largest >= bound)){
+        throw runtime_error("\nInvalid snapshot file: corrupted contract columns\n");
+    }
+}
+
+
+vector<CustomerConflict> CRM::load_snapshot(string file_path){
+
+    shared_ptr<MappedFile> file = make_shared<MappedFile>(file_path);
+    const SnapshotHeader& header = read_snapshot_header(*file);
+
+    const uint64_t* string_offsets = file->at<uint64_t>(header.string_offsets_offset);
+    const char* string_data = file->at<char>(header.string_data_offset);
+    const SnapshotCustomer* customers = file->at<SnapshotCustomer>(header.customers_offset);
+    const uint32_t* name_column = file->at<uint32_t>(header.name_column_offset);
+    const float* money_column = file->at<float>(header.money_column_offset);
+    const int32_t* datetime_column = file->at<int32_t>(header.datetime_column_offset);
+    const uint32_t* datetime_order = file->at<uint32_t>(header.datetime_order_offset);
+    const uint32_t* money_order = file->at<uint32_t>(header.money_order_offset);
+
+    ////////////////////////////////////////////////
+    // check the tables before using them, a corrupted file must not lead to reads outside of the mapping
+
+    (this->logger)->logfile << "Checking snapshot of " << header.customer_count << " customers and " << header.contract_count << " contracts...";
+    if(string_offsets[0] != 0){
+        throw runtime_error("\nInvalid snapshot file: corrupted string table\n");
+    }
+    for(uint64_t i = 0; i < header.string_count; i++){
+        if((string_offsets[i + 1] < string_offsets[i]) || (string_offsets[i + 1] > header.string_bytes)){
+            throw runtime_error("\nInvalid snapshot file: corrupted string table\n");
+        }
+    }
+    for(uint64_t i = 0; i < header.customer_count; i++){
+        const SnapshotCustomer& customer = customers[i];
+        if((customer.name_id >= header.string_count) || (customer.surname_id >= header.string_count)
+            || (customer.first_contract > header.contract_count) || (customer.contract_count > header.contract_count - customer.first_contract)){
+            throw runtime_error("\nInvalid snapshot file: corrupted customer table\n");
+        }
+        check_snapshot_column(datetime_order + customer.first_contract, customer.contract_count, customer.contract_count);
+        check_snapshot_column(money_order + customer.first_contract, customer.contract_count, customer.contract_count);
+    }
+    check_snapshot_column(name_column, header.contract_count, header.contract_name_count);
+    (this->logger)->logfile << " Done" << endl;
+
+    auto snapshot_string = [&](uint64_t id){
+        return string_view(string_data + string_offsets[id], string_offsets[id + 1] - string_offsets[id]);
+    };
+
+    ////////////////////////////////////////////////
+    // build the customers. With no data loaded yet the records are views over the mapped columns, otherwise the contracts are copied
+
+    bool zero_copy = this->customer_record.empty() && (ContractRecord::names.size() == 0);
+    if(zero_copy){
+        ContractRecord::names.attach_mapped_names(file, string_offsets, string_data, header.contract_name_count);
+    }
+    (this->logger)->logfile << "Loading snapshot " << (zero_copy ? "in place" : "by copy") << "...";
+
+    vector<CustomerConflict> conflicts;
+    this->customer_record.reserve(this->customer_record.size() + header.customer_count);
+    this->customer_index.reserve(this->customer_record.size() + header.customer_count);
+
+    for(uint64_t i = 0; i < header.customer_count; i++){
+        const SnapshotCustomer& entry = customers[i];
+        Customer customer(string(snapshot_string(entry.name_id)), string(snapshot_string(entry.surname_id)));
+        ContractRecord& contract_record = customer.get_contract_record();
+        uint64_t first = entry.first_contract;
+
+        if(zero_copy){
+            contract_record.attach_mapped_columns(name_column + first, money_column + first, datetime_column + first,
+                                                  datetime_order + first, money_order + first, entry.contract_count);
+        }
+        else{
+            for(uint64_t j = first; j < first + entry.contract_count; j++){
+                contract_record.add_contract(snapshot_string(name_column[j]), money_column[j], datetime_column[j]);
+            }
+        }
+        this->merge_customer(customer, conflicts);
+    }
+    (this->logger)->logfile << " Done. " << conflicts.size() << " conflicts found." << endl;
+
+    return conflicts;
+}
+
+
+// once the journal grows past this size, it is folded into a new snapshot so that replaying it at startup stays quick
+static const uint64_t journal_compaction_size = 64 << 20;
+
+
+string CRM::store_path(const string& file_name) const{
+    return (filesystem::path(this->store_directory) / file_name).string();
+}
+
+
+void CRM::open_store(const string& directory, JournalOptions journal_options){
+
+    if(!(this->customer_record.empty()) || (this->journal != nullptr)){
+        (this->logger)->logfile << "An error occurred trying to open the data store " << directory << " with data already loaded" << endl;
+        throw runtime_error("\nAn error occurred trying to open the data store " + directory + " with data already loaded\n");
+    }
+
+    (this->logger)->logfile << "Opening data store " << directory << "..." << endl;
+    filesystem::create_directories(directory);
+    this->store_directory = directory;
+
+    uint64_t generation = 0;
+    string snapshot_path = this->store_path(string("data") + snapshot_extension);
+    if(filesystem::exists(snapshot_path)){
+        generation = read_snapshot_generation(snapshot_path);
+        // a snapshot is written from customers with distinct names, a conflict means it is corrupted and resolving it would drop a customer
+        vector<CustomerConflict> conflicts = this->load_snapshot(snapshot_path);
+        if(!(conflicts.empty())){
+            Customer& customer = conflicts.front().incoming;
+            (this->logger)->logfile << "Invalid data store " << directory << ": customer " << customer.get_name() << " " << customer.get_surname()
+                                    << " appears more than once in the snapshot" << endl;
+            throw runtime_error("\nInvalid data store " + directory + ": customer " + customer.get_name() + " " + customer.get_surname() + " appears more than once in the snapshot\n");
+        }
+    }
+
+    // the journal is only attached after the replay, so that the replayed edits are not recorded again
+    (this->logger)->logfile << "Replaying the journal...";
+    string journal_path = this->store_path("data.journal");
+    uint64_t valid_size = Journal::replay(journal_path, generation, [this](const JournalRecord& record){ this->apply_journal_record(record); });
+    this->journal = make_shared<Journal>(journal_path, generation, valid_size, journal_options);
+    (this->logger)->logfile << " Done" << endl;
+
+    if(this->journal->size() > journal_compaction_size){
+        this->compact();
+    }
+    (this->logger)->logfile << "Data store opened: " << this->customer_record.size() << " customers." << endl << SEPARATOR_LINE << endl;
+}
+
+
+void CRM::journal_edit(const JournalRecord& record){
+
+    if(this->journal == nullptr){
+        return;
+    }
+
+    this->journal->append(record);
+    if(this->journal->size() > journal_compaction_size){
+        this->compact();
+    }
+}
+
+
+void CRM::apply_journal_record(const JournalRecord& record){
+
+    if(record.type == JournalRecordType::add_customer){
+        if(!(this->add_customer(record.customer_name, record.customer_surname))){
+            throw runtime_error("\nInvalid journal: customer " + record.customer_name + " " + record.customer_surname + " added twice\n");
+        }
+        return;
+    }
+
+    CustomerHandle handle = this->find_customer(record.customer_name, record.customer_surname);
+    Customer* customer = this->customer_record.get(handle);
+    if(customer == nullptr){
+        throw runtime_error("\nInvalid journal: customer " + record.customer_name + " " + record.customer_surname + " not found\n");
+    }
+
+    Contract contract;
+    bool contract_edit = (record.type == JournalRecordType::delete_contract) || (record.type == JournalRecordType::set_contract_name)
+                        || (record.type == JournalRecordType::set_contract_datetime) || (record.type == JournalRecordType::set_contract_money);
+    if(contract_edit){
+        contract = customer->get_contract_record().search_contract_duplicate(record.contract_name);
+        if(!(contract.is_valid())){
+            throw runtime_error("\nInvalid journal: contract " + record.contract_name + " of customer " + record.customer_name + " " + record.customer_surname + " not found\n");
+        }
+    }
+
+    // an edit refused during the replay would silently lose data, as it was accepted when journaled
+    string datetime_string = format_datetime_days(record.datetime);
+    bool applied = true;
+    switch(record.type){
+        case JournalRecordType::delete_customer:
+            this->delete_customer(handle);
+            break;
+        case JournalRecordType::set_customer_name:
+            applied = this->edit_customer_id(handle, "name", record.new_value);
+            break;
+        case JournalRecordType::set_customer_surname:
+            applied = this->edit_customer_id(handle, "surname", record.new_value);
+            break;
+        case JournalRecordType::add_contract:
+            applied = this->add_contract(customer, record.contract_name, record.money, datetime_string);
+            break;
+        case JournalRecordType::delete_contract:
+            this->delete_contract(customer, contract);
+            break;
+        case JournalRecordType::set_contract_name:
+            applied = this->set_contract_name(customer, contract, record.new_value);
+            break;
+        case JournalRecordType::set_contract_datetime:
+            this->set_contract_datetime(customer, contract, datetime_string);
+            break;
+        case JournalRecordType::set_contract_money:
+            this->set_contract_money(customer, contract, record.money);
+            break;
+        default:
+            break;
+    }
+    if(!(applied)){
+        throw runtime_error("\nInvalid journal: an edit of customer " + record.customer_name + " " + record.customer_surname + " conflicts with the existing data\n");
+    }
+}
+
+
+void CRM::compact(){
+
+    if(this->journal == nullptr){
+        return;
+    }
+
+    (this->logger)->logfile << "Compacting the journal into a new snapshot...";
+    this->journal->flush();
+
+    // the new snapshot is written aside and then renamed over the old one, so that a crash leaves either of them in place.
+    // A snapshot still mapped keeps its content after being replaced
+    uint64_t generation = this->journal->get_generation() + 1;
+    string snapshot_path = this->store_path(string("data") + snapshot_extension);
+    string temporary_path = snapshot_path + ".tmp";
+    this->save_snapshot(temporary_path, generation);
+    sync_path(temporary_path);
+    filesystem::rename(temporary_path, snapshot_path);
+    sync_path(this->store_directory);
+
+    // from now on the journal of the previous generation is ignored, even if emptying it does not complete
+    this->journal->reset(generation);
+    (this->logger)->logfile << " Done" << endl;
+}
+
+
+vector<CustomerConflict> CRM::merge_customers(vector<Customer>& incoming){
+
+    vector<CustomerConflict> conflicts;
+
+    (this->logger)->logfile << "Merging " << incoming.size() << " customers into the customer record...";
+    this->customer_record.reserve(this->customer_record.size() + incoming.size());
+    this->customer_index.reserve(this->customer_record.size() + incoming.size());
+
+    for(Customer& customer: incoming){
+        this->merge_customer(customer, conflicts);
+    }
+    (this->logger)->logfile << " Done. " << conflicts.size() << " conflicts found." << endl;
+
+    return conflicts;
+}
+
+
+void CRM::merge_customer(Customer& customer, vector<CustomerConflict>& conflicts){
+
+    CustomerHandle customer_duplicate = this->find_customer(customer.get_name(), customer.get_surname());
+
+    if(customer_duplicate.is_null()){ // no duplicate is found, free to proceed with adding the new customer
+        CustomerHandle handle = this->customer_record.insert(move(customer));
+        this->index_customer(handle.slot);
+    }
+    else{
+        conflicts.push_back({customer_duplicate, move(customer)});
+    }
+}
+
+
+void CRM::merge_staged_customer(StagedCustomer& staged, vector<CustomerConflict>& conflicts){
+
+    Customer customer(string(staged.name), string(staged.surname));
+    ContractRecord& contract_record = customer.get_contract_record();
+    for(StagedContract& contract: staged.contracts){
+        contract_record.add_contract(contract.name, contract.money, contract.datetime);
+    }
+    this->merge_customer(customer, conflicts);
+}
+
+
+void CRM::overwrite_customer(CustomerConflict& conflict){
+    // name and surname are the same, so only the contracts are replaced, in place and without touching the index
+    Customer* customer = this->customer_record.get(conflict.existing);
+    ContractRecord& contract_record = customer->get_contract_record();
+    contract_record.replace_contracts(move(conflict.incoming.get_contract_record()));
+
+    if(this->journal == nullptr){
+        return;
+    }
+
+    // the replacement is journaled as the customer being deleted and added again with its new contracts. The records are appended
+    // before the journal may be compacted, which would otherwise fold part of them into the snapshot
+    this->journal->append({JournalRecordType::delete_customer, customer->get_name(), customer->get_surname()});
+    this->journal->append({JournalRecordType::add_customer, customer->get_name(), customer->get_surname()});
+    for(size_t position = 0; position < contract_record.size(); position++){
+        JournalRecord record = {JournalRecordType::add_contract, customer->get_name(), customer->get_surname(), string(contract_record.get_name(position))};
+        record.money = contract_record.get_money(position);
+        record.datetime = contract_record.get_datetime(position);
+        this->journal->append(record);
+    }
+    if(this->journal->size() > journal_compaction_size){
+        this->compact();
+    }
+}
+
+
+void CRM::resolve_conflicts_CLI(vector<CustomerConflict>& conflicts){
+
+    if(conflicts.size() == 0){
+        return;
+    }
+
+    (this->logger)->logfile << "Resolving conflicts with existing customers..." << endl;
+
+    string prompt;
+    cout << endl << "The following customers already exist:" << endl;
+    for(size_t i = 0; i < conflicts.size(); i++){
+        cout << i+1 << ") " << conflicts[i].incoming.get_name() << " " << conflicts[i].incoming.get_surname() << endl;
+    }
+
+    prompt = "Do you want to overwrite all of them? Type 'y' for yes and 'n' to choose customer by customer.";
+    if(read_user_answer(prompt, this->logger)){
+        for(CustomerConflict& conflict: conflicts){
+            this->overwrite_customer(conflict);
+        }
+        (this->logger)->logfile << "All the " << conflicts.size() << " conflicting customers overwritten." << endl;
+        return;
+    }
+
+    // otherwise let the user decide customer by customer
+    for(CustomerConflict& conflict: conflicts){
+        prompt = string("Customer ") + conflict.incoming.get_name() + string(" ") + conflict.incoming.get_surname() + string(" already exists. Do you want to overwrite it? Type 'y' for yes and 'n' for no." );
+        if(read_user_answer(prompt, this->logger)){
+            this->overwrite_customer(conflict);
+        }
+    }
+    (this->logger)->logfile << "Conflicts resolved." << endl;
+}
+
+
+
+void to_json(json& j, const CRM& crm) {
+    json customers = json::array();
+    for(const Customer& customer: crm.customer_record){
+        customers.push_back(customer);
+    }
+    j = json{{"customer_record", customers}};
+}
+
+void write_json(JsonWriter& writer, const CRM& crm) {
+    writer.begin_object();
+    writer.key("customer_record");
+    writer.begin_array();
+    for(const Customer& customer: crm.customer_record){
+        write_json(writer, customer);
+    }
+    writer.end_array();
+    writer.end_object();
+}
+
+void from_json(const json& j, CRM& crm) {
+
+    // load the incoming customers and merge them with a single pass over the hash index, then let the user resolve the duplicates
+    vector<Customer> incoming;
+    j.at("customer_record").get_to(incoming);
+
+    vector<CustomerConflict> conflicts = crm.merge_customers(incoming);
+    crm.resolve_conflicts_CLI(conflicts);
+}
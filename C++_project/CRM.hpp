@@ -5,14 +5,78 @@
 #include <string>
 #include <fstream>
 #include <algorithm>
+#include <unordered_map>
 #include "utils.hpp"
+#include "StringArena.hpp"
 #include "Customer.hpp"
+#include "CustomerStore.hpp"
+#include "Journal.hpp"
 
 
 using namespace std;
 
 
 
+/**
+ * @struct CustomerConflict
+ * @brief Pairs a customer being loaded with the existing customer having the same name and surname.
+ *
+ * Conflicts are collected while merging loaded data so that they can be resolved by the user in a single batch.
+ */
+struct CustomerConflict{
+    CustomerHandle existing;    // the customer already registered
+    Customer incoming;          // the customer being loaded
+};
+
+
+/**
+ * @struct StagedContract
+ * @brief Fields of a contract read from a data file, not added to any contract record yet.
+ * The name points into the StringArena the contract was read into.
+ */
+struct StagedContract{
+    string_view name;
+    float money;
+    int32_t datetime;           // day number, see parse_datetime_string
+};
+
+
+/**
+ * @struct StagedCustomer
+ * @brief A customer read from a data file, held as plain values until it is merged into the customer record.
+ *
+ * Staged customers share nothing with the CRM (such as the names table or the logger), so data files can be read by several threads at once.
+ * Their names point into the StringArena they were read into, which must outlive them.
+ */
+struct StagedCustomer{
+    string_view name;
+    string_view surname;
+    vector<StagedContract> contracts;
+};
+
+
+/**
+ * @struct StagedFile
+ * @brief The customers read from one data file, together with the arena that holds all their strings.
+ * The strings of the file are copied once into the arena while parsing, and freed all at once with it when the file has been merged.
+ */
+struct StagedFile{
+    StringArena strings;
+    vector<StagedCustomer> customers;
+};
+
+
+/**
+ * @struct ContractMatch
+ * @brief Result of a query over the contracts of all the customers: a contract together with the customer it belongs to.
+ * The pointer to the customer stays valid until the customer is deleted.
+ */
+struct ContractMatch{
+    Customer* customer;
+    Contract contract;
+};
+
+
 /**
  * @class CRM
  * @brief Implements a Customer Relationship Management system. 
@@ -21,12 +85,26 @@ using namespace std;
  */
 class CRM{
     private:
-        // customers are stored in a vector of Customer objects
-        vector<Customer> customer_record;
+        // customers are stored in a slot map: they never move in memory, and are referred to by handles that detect deleted customers
+        CustomerStore customer_record;
+
+        // hash index from the normalized (lowercase) name/surname key to the slots in customer_record of the customers sharing that key.
+        // Keys are case-insensitive while duplicates are case-sensitive, so a single key can map to more than one customer.
+        unordered_map<string, vector<uint32_t>> customer_index;
+
+        // inverted index from the grams (substrings of 1 to 3 characters) of the lowercase names and surnames to the slots of the customers containing them.
+        // Words of up to 3 characters are looked up directly, longer words through the intersection of the lists of their trigrams.
+        // Deleted and renamed customers only leave stale entries, dropped lazily, so that unindexing a customer takes constant time
+        StampedGramIndex customer_grams;
 
         // shared pointer to the Logger object
         shared_ptr<Logger> logger;
 
+        // data store: directory holding the last snapshot and the journal of the edits made since, see open_store.
+        // The journal is null when no data store is used, or while the journal is being replayed
+        string store_directory = "";
+        shared_ptr<Journal> journal;
+
         // handle the CLI menu options
         int customer_menu_possible_actions;
         int main_menu_possible_actions;
@@ -35,19 +113,56 @@ class CRM{
         int contract_menu_possible_actions;
         int edit_contract_menu_possible_actions;
 
+        /** Builds the normalized key used by the customer hash index
+         * @param name: the name of the customer
+         * @param surname: the surname of the customer
+         * @returns the lowercase name and surname joined by a separator that cannot appear in user input
+        */
+        static string customer_key(const string& name, const string& surname);
+
+        /** Adds the customer stored in a given slot of customer_record to the hash index and to the gram index */
+        void index_customer(uint32_t slot);
+
+        /** Removes the customer stored in a given slot of customer_record from the hash index and from the gram index */
+        void unindex_customer(uint32_t slot);
+
+        /** Finds the slots of the customers whose lowercase name or surname contains a given word, through the gram index
+         * @param word: lowercase word to look for
+         * @param slots: vector the slots of the matching customers are appended to
+        */
+        void search_customer_word(const string& word, vector<uint32_t>& slots);
+
+        /** Records an edit in the journal, if a data store is used, and compacts the journal once it grew too large
+         * @param record: the edit, already applied
+        */
+        void journal_edit(const JournalRecord& record);
+
+        /** Applies an edit read from the journal, throws if it refers to a customer or contract which does not exist */
+        void apply_journal_record(const JournalRecord& record);
+
+        /** Returns the path of a file of the data store
+         * @param file_name: name of the file within the store directory
+        */
+        string store_path(const string& file_name) const;
+
     public:
 
         // default contructor, used in loading data from file
         CRM();
 
-        /** Public constructor for the CRM class
+        /** Public constructor for the CRM class. The CRM is headless: it is driven through its methods, by main_menu for the
+         * interactive interface or by a BatchRunner for command files
          * @param logfile_path: the name/path to the logging file
+         * @param logger_options: format, level and flush policy of the log
+         * @param store_directory: directory of the data store to open, see open_store. No data store is used if empty
         */
-        CRM(string logfile_path);
+        CRM(string logfile_path, LoggerOptions logger_options = LoggerOptions(), string store_directory = "");
 
 
          /** Getter for the collection of customer objects */
-        vector<Customer>& get_customer_record();
+        CustomerStore& get_customer_record();
+
+        shared_ptr<Logger> get_logger();
 
 
         //////////////////////////////////////////////////////////////////
@@ -56,17 +171,17 @@ class CRM{
         /** Shows the main menu interface */
         void main_menu();
 
-        /** Shows the customer menu interface */
-        void customer_menu(Customer* customer);
+        /** Shows the customer menu interface, until the user goes back or the customer is deleted */
+        void customer_menu(CustomerHandle handle);
 
         /** Shows the edit customer menu interface */
-        void edit_customer_menu(Customer* customer);
+        void edit_customer_menu(CustomerHandle handle);
 
         /** Shows the contract menu interface */
         void contract_menu(Customer* customer);
 
         /** Shows the edit contract menu interface */
-        void edit_contract_menu(Customer* customer, Contract* contract);
+        void edit_contract_menu(Customer* customer, Contract contract);
 
         /** Shows the search contract menu interface */
         void search_contract_menu(Customer* customer);
@@ -108,33 +223,54 @@ class CRM{
         void search_contract_by_money_CLI(Customer* customer);
 
         /** Allows the user to edit the name of an existing contract
-         * @param contract: pointer to the Contract object whose information can be edited
+         * @param customer: pointer to the Customer the contract belongs to, whose contract names must stay unique
+         * @param contract: view over the contract whose information can be edited
         */
-        void edit_contract_name_CLI(Contract* contract);
+        void edit_contract_name_CLI(Customer* customer, Contract contract);
 
         /** Allows the user to edit the datetime of an existing contract
-         * @param contract: pointer to the Contract object whose information can be edited
+         * @param customer: pointer to the Customer the contract belongs to
+         * @param contract: view over the contract whose information can be edited
+        */
+        void edit_contract_datetime_CLI(Customer* customer, Contract contract);
+
+        /** Allows the user to search among contracts belonging to a specific customer by their datetime and amount of money at the same time
+         * @param customer: pointer to the Customer whose contracts can be searched
+        */
+        void search_contract_by_datetime_and_money_CLI(Customer* customer);
+
+        /** Allows the user to list the contracts of a specific customer worth the most money
+         * @param customer: pointer to the Customer whose contracts can be searched
         */
-        void edit_contract_datetime_CLI(Contract* contract);
+        void search_top_contracts_by_money_CLI(Customer* customer);
 
         /** Allows the user to edit the money for an existing contract
-         * @param contract: pointer to the Contract object whose information can be edited
+         * @param customer: pointer to the Customer the contract belongs to
+         * @param contract: view over the contract whose information can be edited
         */
-        void edit_contract_money_CLI(Contract* contract);
+        void edit_contract_money_CLI(Customer* customer, Contract contract);
 
         /** Edits the name or surname of a given customer
-         * @param customer: pointer to the Customer object whose id field should be edited
+         * @param handle: handle of the customer whose id field should be edited
          * @param id_field: string indicating whether the name or surname should be edited
          */
-        void edit_customer_id_CLI(Customer* customer, string id_field);
+        void edit_customer_id_CLI(CustomerHandle handle, string id_field);
 
 
+        /** Allows the user to search the contracts of all the customers at once by name, datetime and money */
+        void search_all_contracts_CLI();
+
         /** Allows the user to load customers' data from a file */
         void load_CLI();
 
         /** Allows the user to save customers' data into a file */
         void save_CLI();
 
+        /** Lets the user decide, in a single batch, which of the existing customers conflicting with loaded ones should be overwritten
+         * @param conflicts: the conflicts collected by merge_customers
+        */
+        void resolve_conflicts_CLI(vector<CustomerConflict>& conflicts);
+
 
 
         //////////////////////////////////////////////////////////////////
@@ -145,17 +281,81 @@ class CRM{
         /** Adds a new customer to the customer list 
          * @param name: the name of the customer
          * @param surname: the surname of the customer
-         * 
-         * if duplicates are created by adding the new customer the 
-         * process is stopped and a message is printed to the user
+         * @returns false if a customer with the same name and surname already exists, in which case nothing is added
+        */
+        bool add_customer(string name, string surname);
+
+
+        /** Retrieves the customer with exactly the given name and surname in constant time through the hash index
+         * @param name: the name of the customer
+         * @param surname: the surname of the customer
+         * @returns handle of the matching customer, a null handle if no such customer exists
+        */
+        CustomerHandle find_customer(const string& name, const string& surname);
+
+        /** Retrieves a customer from its handle
+         * @param handle: handle of the customer
+         * @returns pointer to the customer, valid until the customer is deleted. nullptr if the handle is null or the customer was deleted
+        */
+        Customer* get_customer(CustomerHandle handle);
+
+
+        /** Delete an existing customer in constant time: the other customers keep their place, and the indexes are updated rather than rebuilt
+         * @param handle: handle of the customer to delete, throws if the customer does not exist
         */
-        void add_customer(string name, string surname);
+        void delete_customer(CustomerHandle handle);
 
+        /** Edits the name or surname of a given customer, keeping the indexes up to date
+         * @param handle: handle of the customer whose id field should be edited
+         * @param id_field: "name" or "surname"
+         * @param new_value: the new name or surname
+         * @returns false, leaving the customer unchanged, if another customer already has the resulting name and surname
+         */
+        bool edit_customer_id(CustomerHandle handle, const string& id_field, const string& new_value);
+
+        /** Adds a new contract to the record of a customer, unless the customer already has a contract with the same name
+         * @param customer: pointer to the customer
+         * @param contract_name: the name of the new contract
+         * @param money: the amount of money the new contract is worth
+         * @param datetime_string: the date when the contract was signed, already validated
+         * @returns false if the customer already has a contract with the same name, in which case nothing is added
+        */
+        bool add_contract(Customer* customer, string contract_name, float money, string datetime_string);
 
-        /** Delete an existing customer
-         * @param customer: pointer to the customer to delete
+        /** Deletes a contract of a customer
+         * @param customer: pointer to the customer the contract belongs to
+         * @param contract: view over the contract to delete
         */
-        void delete_customer(Customer* customer);
+        void delete_contract(Customer* customer, Contract contract);
+
+        /** Deletes all the contracts of a customer signed before a given day, each deletion being journaled as a single one
+         * @param customer: pointer to the customer
+         * @param before_days: the contracts signed before this day number are deleted, see parse_datetime_string
+         * @returns the number of deleted contracts
+        */
+        size_t purge_contracts(Customer* customer, int32_t before_days);
+
+        /** Renames a contract of a customer
+         * @param customer: pointer to the customer the contract belongs to
+         * @param contract: view over the contract to rename
+         * @param new_name: the new name of the contract
+         * @returns false if another contract of the customer already has the new name, in which case the contract is not renamed
+        */
+        bool set_contract_name(Customer* customer, Contract contract, const string& new_name);
+
+        /** Sets the datetime of a contract of a customer
+         * @param customer: pointer to the customer the contract belongs to
+         * @param contract: view over the contract to edit
+         * @param new_datetime_string: the new datetime of the contract, already validated
+        */
+        void set_contract_datetime(Customer* customer, Contract contract, string& new_datetime_string);
+
+        /** Sets the money of a contract of a customer
+         * @param customer: pointer to the customer the contract belongs to
+         * @param contract: view over the contract to edit
+         * @param new_money: the new amount of money the contract is worth
+        */
+        void set_contract_money(Customer* customer, Contract contract, float new_money);
 
         /**
          * Prints the list of all the current customers. 
@@ -166,55 +366,166 @@ class CRM{
 
         /** Retrieves all the existing customers that are a match for a fuzzy search by name and/or surname
          * @param user_input_string: vector of strings that can include the name and/or the surname of the customer to look for
-         * @returns: a vector of pointers to the customers matching the fuzzy search
+         * @returns: the handles of the customers matching the fuzzy search, in the order of the customer record
          */
-        vector<Customer*> search_customer_matches(vector<string> user_input_strings);
+        vector<CustomerHandle> search_customer_matches(vector<string> user_input_strings);
     
 
         /** Tries to retrieve a customer after a fuzzy search by name and/or surname.
          * @param user_input_strings: vector of strings that can include the name and/or the surname of the customer to look for
          * @param CLI_mode: boolean variable to indicate if messages should be printed to screen. By default it is true, false is set
          * only when calling this function during data loading from file.
-         * @return : a pointer to the customer retrieved by the search if an exact match was found,
-         * or selected by the user if an exact match was not found. The pointer can be null
+         * @return : the handle of the customer retrieved by the search if an exact match was found,
+         * or selected by the user if an exact match was not found. The handle is null
          * if the user cancels the operation of if no potentially matching customers were found
          * in the first place.
          */       
-        Customer* select_customer(vector<string> user_input_strings, bool CLI_mode=true);
+        CustomerHandle select_customer(const vector<string>& user_input_strings, bool CLI_mode=true);
 
         /**
          * After a contract search which did not find an exact match, this function 
          * allows the user to select one of the potential matches that were found.
          * @param contracts: potential matching contracts that were found by searching
-         * @return : a pointer to the contract by the user selected. The pointer can be null
+         * @return : a view over the contract by the user selected. The view is not valid
          * if the user cancels the operation of if no potentially matching contracts were found
          * in the first place.
          */
-        Contract* select_contract(vector<Contract*> contracts);
+        Contract select_contract(vector<Contract> contracts);
+
+        /**
+         * Retrieves the contracts of all the customers satisfying the conditions of a query, in a single pass over the customer record
+         * @param query: the conditions on name, datetime and money
+         * @returns the matching contracts, each with the customer it belongs to. When a name is given, the most relevant names come first
+         */
+        vector<ContractMatch> search_contracts(const ContractQuery& query);
 
         /**
-        * Sorts the customer list alphabetically
+        * Sorts the customer list alphabetically. Only the order of the customers changes: they are not moved, and handles and indexes stay valid
         */
         void sort_alphabetically();
 
         /**
-         * allows the user to save customer data to a given file
+         * allows the user to save customer data to a given file.
+         * Customers are streamed to the file one at a time through a JsonWriter, without building a json object of the whole customer record.
+         * The output is the same as the json library's dump of to_json
          * @param file_path: path for the file to where data should be dumped
-         * @param j: json object to manage json data serialization, see https://github.com/nlohmann/json/releases/latest/download/json.hpp
+         * @param pretty: whether to write indented json, as dump(4), or compact json, as dump()
+         */
+        void save(string file_path, bool pretty = true);
+
+        /**
+         * Saves the customer data to a file, as a binary snapshot if the path has the snapshot extension and as json otherwise
+         * @param file_path: path for the file to where data should be written
+         * @param pretty: whether json is indented, see save
          */
-        void save(string file_path, json& j);
+        void save_data(const string& file_path, bool pretty = true);
 
         /**
-         * allows the user to load customer data from a given file
+         * Loads customer data from a snapshot, a json file or the json files of a directory, the format being recognized from the path and the first bytes of the file.
+         * A single json file is loaded by load, several by load_files
+         * @param path: path of the file or directory from where data should be loaded
+         * @returns the loaded customers having the same name and surname as existing ones, which were not added
+         */
+        vector<CustomerConflict> load_data(const string& path);
+
+        /**
+         * allows the user to load customer data from a given file.
+         * The file is parsed as a stream of tokens (nlohmann SAX interface): customers and contracts are built as they are read and merged into the
+         * customer record one at a time, so that no document object holding the whole file is ever built
          * @param file_path: path for the file from where data should be loaded
-         * @param j: json object to manage json data deserialization, see https://github.com/nlohmann/json/releases/latest/download/json.hpp
+         * @returns the loaded customers having the same name and surname as existing ones, which were not added
          */
-        void load(string file_path, json& j);
+        vector<CustomerConflict> load(string file_path);
+
+        /**
+         * Loads customer data from several json files at once. The files are parsed concurrently by a pool of threads, each file into its own staging
+         * area of plain values, while the calling thread merges the staged customers into the customer record file after file, in the order of the paths.
+         * The threads stay at most thread_count + 1 files ahead of the merge, which bounds the memory held by the staged files.
+         * Duplicates are handled as by load: the result is the same as loading the files one after the other, and the conflicts of all the files are returned together
+         * @param file_paths: paths of the files to load
+         * @param thread_count: number of parsing threads, by default one per core
+         * @returns the loaded customers having the same name and surname as existing ones (or as customers of previous files), which were not added
+         */
+        vector<CustomerConflict> load_files(const vector<string>& file_paths, size_t thread_count = 0);
+
+        /**
+         * Lists the data files to load from a path: the path itself if it is a file, or the json files it contains, sorted by name, if it is a directory
+         * @param path: path of a file or directory
+         */
+        static vector<string> list_data_files(const string& path);
+
+        /**
+         * Saves the customer data to a binary snapshot file (see Snapshot.hpp): a table of strings, a table of customers, and the fields of all the contracts
+         * stored column by column. Snapshots are much faster to load than json files, but are only meant to be read back by this program on the same kind of machine
+         * @param file_path: path for the file to where data should be written
+         * @param generation: generation of the snapshot within a data store, see compact
+         */
+        void save_snapshot(string file_path, uint64_t generation = 0);
+
+        /**
+         * Loads customer data from a binary snapshot file written by save_snapshot.
+         * When nothing was loaded or added before, the file is memory mapped and the contract records read their columns in place: only the
+         * customers are built, so that loading takes a time proportional to the number of customers. A record copies its columns when first edited.
+         * Otherwise the contracts are copied into the existing data, as when loading a json file
+         * @param file_path: path for the file from where data should be loaded
+         * @returns the loaded customers having the same name and surname as existing ones, which were not added
+         */
+        vector<CustomerConflict> load_snapshot(string file_path);
+
+        /**
+         * Opens a data store: loads its last snapshot, replays the journal of the edits made since, and from then on records every edit in the journal,
+         * so that edits are persisted as they are made at a cost proportional to their size instead of by saving the whole data again.
+         * Journal records are made durable in batches (group commit), see Journal.
+         * Must be called before any data is loaded or added
+         * @param directory: directory of the data store, created if it does not exist
+         * @param journal_options: group commit policy of the journal
+         */
+        void open_store(const string& directory, JournalOptions journal_options = JournalOptions());
+
+        /**
+         * Folds the journal into a new snapshot of the data store and empties it. The new snapshot replaces the old one atomically,
+         * and has a new generation so that a crash before the journal is emptied cannot lead to its edits being replayed twice.
+         * Called automatically after loading data from a file and when the journal grows large
+         */
+        void compact();
+
+        /**
+         * Merges a batch of customers into the customer record with a single pass over the hash index.
+         * Customers without a duplicate are moved into the record straight away, the others are returned as conflicts.
+         * Duplicates within the batch itself are detected as well, since customers are indexed as soon as they are added.
+         * @param incoming: the customers to merge, left in a moved-from state
+         * @returns the conflicts to be resolved, e.g. by resolve_conflicts_CLI
+         */
+        vector<CustomerConflict> merge_customers(vector<Customer>& incoming);
+
+        /**
+         * Merges a single customer into the customer record, see merge_customers
+         * @param customer: the customer to merge, left in a moved-from state
+         * @param conflicts: vector the customer is appended to if a customer with the same name and surname already exists
+         */
+        void merge_customer(Customer& customer, vector<CustomerConflict>& conflicts);
+
+        /**
+         * Builds a customer with its contract record from a staged customer and merges it into the customer record, see merge_customer
+         * @param staged: the customer read from a data file, its strings are copied into the customer
+         * @param conflicts: vector the customer is appended to if a customer with the same name and surname already exists
+         */
+        void merge_staged_customer(StagedCustomer& staged, vector<CustomerConflict>& conflicts);
+
+        /**
+         * Replaces the existing customer involved in a conflict with the incoming one: the contracts are replaced, and the handles to the previous ones
+         * become stale. The replacement is journaled when a data store is open
+         * @param conflict: the conflict to resolve, its incoming customer is left in a moved-from state
+         */
+        void overwrite_customer(CustomerConflict& conflict);
 
         /** Friend functions to manage data saving and loading through the nlohmann json libray: https://github.com/nlohmann/json/releases/latest/download/json.hpp
         */
         friend void to_json(json& j, const CRM& crm);
         friend void from_json(const json& j, CRM& crm);
+
+        /** Streams the customer record to a JsonWriter, producing the same json as to_json */
+        friend void write_json(JsonWriter& writer, const CRM& crm);
 };
 
 
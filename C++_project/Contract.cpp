@@ -5,8 +5,11 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <numeric>
 #include "Contract.hpp"
+#include "simd_filters.hpp"
 #include "utils.hpp"
+#include "Snapshot.hpp"
 
 
 
@@ -15,134 +18,219 @@ using json = nlohmann::json;
 
 
 
-// definition of static field only declared in the header file
-shared_ptr<Logger> Contract::logger;
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// NAME TABLE CLASS
 
 
-Contract::Contract(){};
+uint32_t NameTable::intern(string_view name)
+{
+    this->index_mapped_names();
+
+    auto entry = this->ids.find(name);
+    if(entry != this->ids.end()){
+        return entry->second;
+    }
 
-Contract::Contract(string& _name, float _money, string& _datetime_string)
+    uint32_t id = this->size();
+    this->names.push_back(this->name_storage.store(name));
+    this->ids.emplace(this->names.back(), id);
+    this->index_grams(name, id);
+    return id;
+}
+
+bool NameTable::find_id(string_view name, uint32_t& id)
 {
-    this->name = _name;
-    this->money = _money;
-    this->datetime = {};
-    istringstream in(_datetime_string);
-    in >> get_time(&(this->datetime), date_format.c_str());
+    this->index_mapped_names();
 
-    // Check if parsing succeeded, this should never be a problem as _date_string_string should have been already validated when creating the contract object
-    if (in.fail()) {
-        Contract::logger->logfile << endl << "An error occurred trying to create a contract with datetime string " << _datetime_string << endl;
-        throw runtime_error("\nAn error occurred trying to create a contract with datetime string " + _datetime_string  + "\n");
+    auto entry = this->ids.find(name);
+    if(entry == this->ids.end()){
+        return false;
     }
+    id = entry->second;
+    return true;
 }
 
-void Contract::print()
+void NameTable::index_grams(string_view name, uint32_t id)
 {
-    cout << "Contract name: " << this->name << endl;
-    cout << "Date of the deal: " << this->datetime.tm_year + 1900 << ":" << this->datetime.tm_mon  + 1 << ":" << this->datetime.tm_mday << endl;
-    cout << "Money: " << this->money << endl;
+    vector<uint32_t> name_grams;
+    collect_grams(to_lowercase(string(name)), name_grams);
+    gram_index_insert(this->grams, name_grams, id);
 }
 
+void NameTable::index_mapped_names()
+{
+    if(this->mapped_names_indexed){
+        return;
+    }
 
+    this->ids.reserve(this->size());
+    for(uint32_t id = 0; id < this->mapped_count; id++){
+        this->ids.emplace(this->get_name(id), id);
+        this->index_grams(this->get_name(id), id);
+    }
+    this->mapped_names_indexed = true;
+}
 
-string Contract::get_name()
+void NameTable::attach_mapped_names(shared_ptr<MappedFile> file, const uint64_t* offsets, const char* data, uint32_t count)
 {
-    return this->name;
+    if(this->size() != 0){
+        throw runtime_error("\nAn error occurred trying to load the names of a snapshot into a names table already in use\n");
+    }
+
+    this->mapped_file = file;
+    this->mapped_offsets = offsets;
+    this->mapped_data = data;
+    this->mapped_count = count;
+    this->mapped_names_indexed = (count == 0);
 }
 
-float Contract::get_money()
+string_view NameTable::get_name(uint32_t id) const
 {
-    return this->money;
+    if(id < this->mapped_count){
+        return string_view(this->mapped_data + this->mapped_offsets[id], this->mapped_offsets[id + 1] - this->mapped_offsets[id]);
+    }
+    return this->names[id - this->mapped_count];
 }
 
-
-tm Contract::get_datetime()
+size_t NameTable::size() const
 {
-    return datetime;
+    return this->mapped_count + this->names.size();
 }
 
-void Contract::set_name(string& new_name)
+vector<int8_t> NameTable::rank_names(const string& word)
 {
-    this->name = new_name;
+    this->index_mapped_names();
+
+    vector<int8_t> ranks(this->size(), -1);
+    string lowercase_word = to_lowercase(word);
+
+    // name_match_rank verifies the candidates as well
+    vector<uint32_t> candidates;
+    gram_index_candidates(this->grams, lowercase_word, candidates);
+    for(uint32_t id: candidates){
+        ranks[id] = name_match_rank(to_lowercase(string(this->get_name(id))), lowercase_word);
+    }
+    return ranks;
 }
 
-void Contract::set_money(float new_money)
+void NameTable::find_names(const string& word, vector<uint32_t>& ids)
 {
-    this->money = new_money;
+    this->index_mapped_names();
+
+    if(gram_index_candidates(this->grams, word, ids)){
+        return;
+    }
+
+    // the candidates still need to be verified
+    ids.erase(remove_if(ids.begin(), ids.end(), [&](uint32_t id){
+        return to_lowercase(string(this->get_name(id))).find(word) == string::npos;
+    }), ids.end());
 }
 
-void Contract::set_datetime(string& new_datetime_string)
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// CONTRACT CLASS
+
+
+// definition of static field only declared in the header file
+shared_ptr<Logger> Contract::logger;
+
+
+Contract::Contract()
+    : record(nullptr), slot(0), generation(0)
+{}
+
+Contract::Contract(ContractRecord* _record, uint32_t _slot, uint32_t _generation)
+    : record(_record), slot(_slot), generation(_generation)
+{}
+
+void Contract::print() const
 {
+    chrono::year_month_day date = datetime_from_days(this->get_datetime());
+    cout << "Contract name: " << this->get_name() << endl;
+    cout << "Date of the deal: " << int(date.year()) << ":" << unsigned(date.month()) << ":" << unsigned(date.day()) << endl;
+    cout << "Money: " << this->get_money() << endl;
+}
 
-    istringstream in(new_datetime_string);
-    this->datetime = {}; // Zero it out
-    in >> get_time(&(this->datetime), date_format.c_str());
 
-    // Check if parsing succeeded, this should never be a problem as _date_string_string should have been already validated
-    if (in.fail()) {
-        Contract::logger->logfile << endl << "An error occurred trying to set a contract datetime with datetime string " << new_datetime_string << endl;
-        throw runtime_error("\nAn error occurred trying to set a contract datetime with datetime string " + new_datetime_string  + "\n");
-    } 
 
+string_view Contract::get_name() const
+{
+    return this->record->get_name(this->get_position());
 }
 
+float Contract::get_money() const
+{
+    return this->record->get_money(this->get_position());
+}
 
 
-bool Contract::operator<=(const string datetime_string) const{
+int32_t Contract::get_datetime() const
+{
+    return this->record->get_datetime(this->get_position());
+}
 
-    tm temp_datetime_struct;
-    istringstream in(datetime_string);
-    in >> get_time(&(temp_datetime_struct), date_format.c_str());
+uint32_t Contract::get_slot() const
+{
+    return this->slot;
+}
 
-    // Check if parsing succeeded, this should never be a problem as _date_string_string should have been already validated
-    if (in.fail()) {
-        Contract::logger->logfile << endl << "An error occurred trying to create a datetime struct by datetime string " << datetime_string << endl;
-        throw runtime_error("\nAn error occurred trying to create a datetime struct by datetime string " + datetime_string  + "\n");
-    }
+uint32_t Contract::get_generation() const
+{
+    return this->generation;
+}
 
-    // compare year
-    if(this->datetime.tm_year > temp_datetime_struct.tm_year) return false;
-    else if(this->datetime.tm_year < temp_datetime_struct.tm_year) return true;
-    else{     // compare month
-        if(this->datetime.tm_mon > temp_datetime_struct.tm_mon) return false;
-        if(this->datetime.tm_mon < temp_datetime_struct.tm_mon) return true;
-        else{ // compare day 
-            if(this->datetime.tm_mday > temp_datetime_struct.tm_mday) return false;
-            else return true;
-        }
+size_t Contract::get_position() const
+{
+    size_t position = (this->record != nullptr) ? this->record->find_position(*this) : ContractRecord::no_position;
+    if(position == ContractRecord::no_position){
+        Contract::logger->logfile << endl << "An error occurred trying to access a contract which does not exist" << endl;
+        throw runtime_error("\nAn error occurred trying to access a contract which does not exist\n");
     }
+    return position;
 }
 
-bool Contract::operator>=(const string datetime_string) const{
+ContractRecord* Contract::get_record() const
+{
+    return this->record;
+}
 
-    tm temp_datetime_struct;
-    istringstream in(datetime_string);
-    in >> get_time(&(temp_datetime_struct), date_format.c_str());
+bool Contract::is_valid() const
+{
+    return (this->record != nullptr) && (this->record->find_position(*this) != ContractRecord::no_position);
+}
 
-    // Check if parsing succeeded, this should never be a problem as _date_string_string should have been already validated
-    if (in.fail()) {
-        Contract::logger->logfile << endl << "An error occurred trying to create a datetime struct by datetime string " << datetime_string << endl;
-        throw runtime_error("\nAn error occurred trying to create a datetime struct by datetime string " + datetime_string  + "\n");
-    }
+bool Contract::set_name(const string& new_name)
+{
+    return this->record->rename_contract(*this, new_name);
+}
 
-    // compare year
-    if(this->datetime.tm_year < temp_datetime_struct.tm_year) return false;
-    else if(this->datetime.tm_year > temp_datetime_struct.tm_year) return true;
-    else{     // compare month
-        if(this->datetime.tm_mon < temp_datetime_struct.tm_mon) return false;
-        if(this->datetime.tm_mon > temp_datetime_struct.tm_mon) return true;
-        else{ // compare day 
-            if(this->datetime.tm_mday < temp_datetime_struct.tm_mday) return false;
-            else return true;
-        }
-    }
+void Contract::set_money(float new_money)
+{
+    this->record->set_contract_money(*this, new_money);
+}
+
+void Contract::set_datetime(string& new_datetime_string)
+{
+    this->record->set_contract_datetime(*this, new_datetime_string);
+}
+
+
+
+bool Contract::operator<=(int32_t days) const{
+    return this->get_datetime() <= days;
+}
+
+bool Contract::operator>=(int32_t days) const{
+    return this->get_datetime() >= days;
 }
 
 void to_json(json& j, const Contract& contract) {
     j = json{
-        {"name", contract.name},
-        {"money", contract.money},
-        {"datetime", format_tm(contract.datetime)}
+        {"name", contract.get_name()},
+        {"money", contract.get_money()},
+        {"datetime", format_datetime_days(contract.get_datetime())}
     };
 }
 
@@ -151,13 +239,72 @@ void to_json(json& j, const Contract& contract) {
 /// CONTRACT RECORD CLASS
 
 
-// definition of static field only declared in the header file
+// definition of static fields only declared in the header file
 shared_ptr<Logger> ContractRecord::logger;
+NameTable ContractRecord::names;
+
+
+// helpers for the sorted secondary indexes of ContractRecord, which are vectors of (key, position) pairs sorted by key and then by position
+
+template<typename Key>
+static void sorted_index_insert(vector<pair<Key, size_t>>& index, Key key, size_t position)
+{
+    pair<Key, size_t> entry(key, position);
+    index.insert(lower_bound(index.begin(), index.end(), entry), entry);
+}
+
+// contracts added in bulk (e.g. while loading) are appended to the indexes, and sorted in at once the next time the index is read,
+// rather than inserted one by one in the middle of the index
+template<typename Key>
+static void sorted_index_append(vector<pair<Key, size_t>>& index, Key key, size_t position, bool& sorted)
+{
+    pair<Key, size_t> entry(key, position);
+    if(!(index.empty()) && (entry < index.back())){
+        sorted = false;
+    }
+    index.push_back(entry);
+}
+
+// only the entries after the sorted prefix need sorting, then the two parts are merged in linear time
+template<typename Key>
+static void sorted_index_sort(vector<pair<Key, size_t>>& index, bool& sorted)
+{
+    if(sorted){
+        return;
+    }
+    auto sorted_end = is_sorted_until(index.begin(), index.end());
+    sort(sorted_end, index.end());
+    inplace_merge(index.begin(), sorted_end, index.end());
+    sorted = true;
+}
+
+template<typename Key>
+static void sorted_index_erase(vector<pair<Key, size_t>>& index, Key key, size_t position)
+{
+    auto iterator = lower_bound(index.begin(), index.end(), pair<Key, size_t>(key, position));
+    if((iterator != index.end()) && (iterator->second == position)){
+        index.erase(iterator);
+    }
+}
+
+// when the columns are compacted, the entries of the deleted contracts are dropped and the others get their new positions.
+// Positions keep their relative order, so the index stays sorted
+template<typename Key>
+static void sorted_index_remap(vector<pair<Key, size_t>>& index, const vector<size_t>& new_positions)
+{
+    size_t kept = 0;
+    for(pair<Key, size_t>& entry: index){
+        if(new_positions[entry.second] != ContractRecord::no_position){
+            index[kept++] = {entry.first, new_positions[entry.second]};
+        }
+    }
+    index.resize(kept);
+}
 
 void ContractRecord::print()
 {
 
-    if(this->contract_record.size()==0)
+    if(this->size()==0)
     {
         cout << endl << "No contracts registered for this costumer yet." << endl;
     }
@@ -165,84 +312,658 @@ void ContractRecord::print()
 
         cout << endl << "Contract Record:" << endl;
 
-        for(int i = 0; i < this->contract_record.size(); i++)
+        int i = 0;
+        for(size_t position = 0; position < this->column_size(); position++)
         {
+            if(!(this->is_live(position))){
+                continue;
+            }
 
-            cout << endl << endl << "Contract " << i+1 << ") " << endl << endl;
-            this->contract_record[i].print();
+            cout << endl << endl << "Contract " << ++i << ") " << endl << endl;
+            this->contract_at(position).print();
             cout << endl << endl;
         }
     }
-    
+
 }
 
 
 ContractRecord::ContractRecord(){}
 
 
-vector<Contract>& ContractRecord::get_contract_record(){
-    return this->contract_record;
+size_t ContractRecord::size() const{
+    return this->column_size() - this->tombstones;
 }
 
-Contract* ContractRecord::search_contract_duplicate(string contract_name){
+size_t ContractRecord::column_size() const{
+    return (this->mapped_names != nullptr) ? this->mapped_size : this->name_column.size();
+}
 
-    Contract* duplicate_contract = nullptr;
-    for(Contract& contract: this->contract_record){
-        if(contract.get_name() != contract_name){
-            continue;
-        } 
-        else{
-            duplicate_contract = &contract;
-            break;
+bool ContractRecord::is_live(size_t position) const{
+    return (this->tombstones == 0) || (this->position_slots[position] != tombstone);
+}
+
+void ContractRecord::remove_deleted(vector<size_t>& positions) const{
+    if(this->tombstones == 0){
+        return;
+    }
+    positions.erase(remove_if(positions.begin(), positions.end(), [this](size_t position){ return !(this->is_live(position)); }), positions.end());
+}
+
+const uint32_t* ContractRecord::name_data() const{
+    return (this->mapped_names != nullptr) ? this->mapped_names : this->name_column.data();
+}
+
+const float* ContractRecord::money_data() const{
+    return (this->mapped_names != nullptr) ? this->mapped_money : this->money_column.data();
+}
+
+const int32_t* ContractRecord::datetime_data() const{
+    return (this->mapped_names != nullptr) ? this->mapped_datetimes : this->datetime_column.data();
+}
+
+Contract ContractRecord::contract_at(size_t position){
+    if(this->slot_positions.empty()){
+        return Contract(this, position, 0);
+    }
+    uint32_t slot = this->position_slots[position];
+    return Contract(this, slot, this->slot_generations[slot]);
+}
+
+size_t ContractRecord::find_position(const Contract& contract) const{
+    uint32_t slot = contract.get_slot();
+    if(contract.get_record() != this){
+        return no_position;
+    }
+    if(this->slot_positions.empty()){
+        return ((slot < this->column_size()) && (contract.get_generation() == 0)) ? slot : no_position;
+    }
+    if((slot >= this->slot_generations.size()) || (this->slot_generations[slot] != contract.get_generation())){
+        return no_position;
+    }
+    return this->slot_positions[slot];
+}
+
+string_view ContractRecord::get_name(size_t position) const{
+    return ContractRecord::names.get_name(this->name_data()[position]);
+}
+
+float ContractRecord::get_money(size_t position) const{
+    return this->money_data()[position];
+}
+
+int32_t ContractRecord::get_datetime(size_t position) const{
+    return this->datetime_data()[position];
+}
+
+uint32_t ContractRecord::get_name_id(size_t position) const{
+    return this->name_data()[position];
+}
+
+
+void ContractRecord::attach_mapped_columns(const uint32_t* names, const float* money, const int32_t* datetimes, const uint32_t* datetime_order, const uint32_t* money_order, size_t count){
+
+    if(this->size() != 0){
+        ContractRecord::logger->logfile << endl << "An error occurred trying to load snapshot contracts into a record which is not empty" << endl;
+        throw runtime_error("\nAn error occurred trying to load snapshot contracts into a record which is not empty\n");
+    }
+    if(count == 0){
+        return;
+    }
+
+    this->mapped_names = names;
+    this->mapped_money = money;
+    this->mapped_datetimes = datetimes;
+    this->mapped_datetime_order = datetime_order;
+    this->mapped_money_order = money_order;
+    this->mapped_size = count;
+    this->sorted_indexes_built = false;
+    this->name_index_built = false;
+}
+
+
+void ContractRecord::build_sorted_indexes(){
+
+    if(!(this->sorted_indexes_built)){
+        // the sorted orders of the snapshot give the sorted indexes directly
+        this->datetime_index.reserve(this->size());
+        this->money_index.reserve(this->size());
+        for(size_t i = 0; i < this->size(); i++){
+            this->datetime_index.push_back({this->mapped_datetimes[this->mapped_datetime_order[i]], this->mapped_datetime_order[i]});
+            this->money_index.push_back({this->mapped_money[this->mapped_money_order[i]], this->mapped_money_order[i]});
         }
+        this->sorted_indexes_built = true;
+    }
+
+    sorted_index_sort(this->datetime_index, this->datetime_index_sorted);
+    sorted_index_sort(this->money_index, this->money_index_sorted);
+}
+
+
+void ContractRecord::build_name_index(){
+
+    if(this->name_index_built){
+        return;
+    }
+
+    this->contract_index.reserve(this->size());
+    for(size_t i = 0; i < this->size(); i++){
+        this->contract_index[this->get_name_id(i)] = i;
+    }
+    this->name_index_built = true;
+}
+
+
+void ContractRecord::make_writable(){
+
+    if(this->mapped_names == nullptr){
+        return;
+    }
+
+    this->build_sorted_indexes();
+    this->build_name_index();
+    this->name_column.assign(this->mapped_names, this->mapped_names + this->mapped_size);
+    this->money_column.assign(this->mapped_money, this->mapped_money + this->mapped_size);
+    this->datetime_column.assign(this->mapped_datetimes, this->mapped_datetimes + this->mapped_size);
+
+    this->mapped_names = nullptr;
+    this->mapped_money = nullptr;
+    this->mapped_datetimes = nullptr;
+    this->mapped_datetime_order = nullptr;
+    this->mapped_money_order = nullptr;
+    this->mapped_size = 0;
+}
+
+
+void ContractRecord::get_sorted_positions(vector<uint32_t>& datetime_order, vector<uint32_t>& money_order){
+
+    datetime_order.clear();
+    money_order.clear();
+    if(!(this->sorted_indexes_built)){
+        datetime_order.assign(this->mapped_datetime_order, this->mapped_datetime_order + this->mapped_size);
+        money_order.assign(this->mapped_money_order, this->mapped_money_order + this->mapped_size);
+        return;
     }
-    return duplicate_contract;
+    this->build_sorted_indexes();
+
+    for(auto [datetime, position]: this->datetime_index){
+        datetime_order.push_back(position);
+    }
+    for(auto [money, position]: this->money_index){
+        money_order.push_back(position);
+    }
+}
+
+size_t ContractRecord::check_contract(const Contract& contract){
+    size_t position = this->find_position(contract);
+    if(position == no_position){
+        ContractRecord::logger->logfile << endl << "An error occurred trying to access a contract not belonging to this record" << endl;
+        throw runtime_error("\nAn error occurred trying to access a contract not belonging to this record\n");
+    }
+    return position;
 }
 
+Contract ContractRecord::search_contract_duplicate(string_view contract_name){
+
+    // a name missing from the names table is not the name of any contract
+    uint32_t name_id;
+    if(!(ContractRecord::names.find_id(contract_name, name_id))){
+        return Contract();
+    }
+    return this->search_contract_duplicate(name_id);
+}
+
+
+Contract ContractRecord::search_contract_duplicate(uint32_t name_id){
 
-void ContractRecord::add_contract(string contract_name, float money, string datetime_string)
+    this->build_name_index();
+    auto entry = this->contract_index.find(name_id);
+    if(entry == this->contract_index.end()){
+        return Contract();
+    }
+    return this->contract_at(entry->second);
+}
+
+
+bool ContractRecord::add_contract(string_view contract_name, float money, string datetime_string)
+{
+    // Check if parsing succeeded, this should never be a problem as datetime_string should have been already validated when creating the contract
+    int32_t datetime;
+    if (!parse_datetime_string(datetime_string, datetime)) {
+        Contract::logger->logfile << endl << "An error occurred trying to create a contract with datetime string " << datetime_string << endl;
+        throw runtime_error("\nAn error occurred trying to create a contract with datetime string " + datetime_string  + "\n");
+    }
+    return this->add_contract(contract_name, money, datetime);
+}
+
+
+bool ContractRecord::add_contract(string_view contract_name, float money, int32_t datetime)
 {
 
-    // check if a contract with the same dat already exists 
+    // check if a contract with the same dat already exists
     ContractRecord::logger->logfile << "Looking for a potential duplicate of contract with the same name...";
-    Contract* potential_duplicate = this->search_contract_duplicate(contract_name);
+    uint32_t name_id = ContractRecord::names.intern(contract_name);
+    Contract potential_duplicate = this->search_contract_duplicate(name_id);
     ContractRecord::logger->logfile << " Done" << endl;
 
-    if(potential_duplicate != nullptr){
-    
-        cout << "A contract named " << contract_name << " already exists." << endl;
+    if(potential_duplicate.is_valid()){
         ContractRecord::logger->logfile << "Adding contract not executed due to existing duplicate" << endl << SEPARATOR_LINE << endl;
-        return;
+        return false;
     }
 
     // if no duplicate was found proceed
-    ContractRecord::logger->logfile << "Adding contract with name " << contract_name << ", money " << money << " and datetime " << datetime_string << "...";
-    Contract new_contract(contract_name, money, datetime_string);
-    this->contract_record.push_back(new_contract);
+    ContractRecord::logger->logfile << "Adding contract with name " << contract_name << ", money " << money << " and datetime " << format_datetime_days(datetime) << "...";
+    this->make_writable();
+    size_t position = this->column_size();
+    if(!(this->slot_positions.empty())){
+        uint32_t slot;
+        if(!(this->free_slots.empty())){
+            slot = this->free_slots.back();
+            this->free_slots.pop_back();
+        }
+        else{
+            slot = this->slot_positions.size();
+            this->slot_positions.push_back(0);
+            this->slot_generations.push_back(0);
+        }
+        this->slot_positions[slot] = position;
+        this->position_slots.push_back(slot);
+    }
+    this->name_column.push_back(name_id);
+    this->money_column.push_back(money);
+    this->datetime_column.push_back(datetime);
+
+    sorted_index_append(this->datetime_index, datetime, position, this->datetime_index_sorted);
+    sorted_index_append(this->money_index, money, position, this->money_index_sorted);
+    this->contract_index.emplace(name_id, position);
     ContractRecord::logger->logfile << " Done"  << endl;
+    return true;
+}
+
+void ContractRecord::delete_contract(Contract contract_to_delete){
+
+    size_t position = this->find_position(contract_to_delete);
+    if(position == no_position){
+        ContractRecord::logger->logfile << endl << "An error occurred trying to delete a contract which does not exist" << endl;
+        throw runtime_error("\nAn error occurred trying to delete a contract which does not exist\n");
+    }
+
+    this->make_writable();
+    this->build_slot_tables();
+    this->contract_index.erase(this->name_column[position]);
+
+    // the contract leaves a tombstone: nothing moves, and the other indexes keep the entries of the position until the next compaction
+    uint32_t slot = this->position_slots[position];
+    this->position_slots[position] = tombstone;
+    this->slot_generations[slot]++;
+    this->free_slots.push_back(slot);
+    this->tombstones++;
+
+    // compacting once half of the positions are tombstones costs a constant time per deleted contract
+    if(2 * this->tombstones > this->column_size()){
+        this->compact();
+    }
 }
 
-void ContractRecord::delete_contract(Contract* contract_to_delete){
 
-    // find the iterator of the object to be deleted, use a lambda function to specify the matching criteria for brevity
-    auto iterator = find_if(this->contract_record.begin(), this->contract_record.end(), [contract_to_delete](Contract& obj) { return &obj == contract_to_delete; });
-    if (iterator != this->contract_record.end()) {
-        this->contract_record.erase(iterator);
+void ContractRecord::build_slot_tables(){
+
+    if(!(this->slot_positions.empty())){
         return;
     }
+
+    // the handles given out so far have the position as slot
+    this->position_slots.resize(this->column_size());
+    iota(this->position_slots.begin(), this->position_slots.end(), 0);
+    this->slot_positions = this->position_slots;
+    this->slot_generations.assign(this->column_size(), 0);
+}
+
+
+void ContractRecord::replace_contracts(ContractRecord&& other){
+
+    // generations of the slots handed out so far, 0 for all of them until a contract is first deleted
+    vector<uint32_t> replaced_generations = this->slot_generations.empty() ? vector<uint32_t>(this->column_size(), 0) : move(this->slot_generations);
+
+    *this = move(other);
+    this->make_writable();
+    this->build_slot_tables();
+
+    // every slot gets a newer generation than any handle to the replaced contracts. The slots not used by the new contracts are free
+    for(uint32_t slot = 0; slot < replaced_generations.size(); slot++){
+        if(slot >= this->slot_generations.size()){
+            this->slot_positions.push_back(0);
+            this->slot_generations.push_back(0);
+            this->free_slots.push_back(slot);
+        }
+        this->slot_generations[slot] = max(this->slot_generations[slot], replaced_generations[slot] + 1);
+    }
+}
+
+
+void ContractRecord::compact(){
+
+    if(this->tombstones == 0){
+        return;
+    }
+
+    // the contracts left are moved to the front of the columns, keeping their order
+    vector<size_t> new_positions(this->column_size(), no_position);
+    size_t live = 0;
+    for(size_t position = 0; position < this->column_size(); position++){
+        uint32_t slot = this->position_slots[position];
+        if(slot == tombstone){
+            continue;
+        }
+        new_positions[position] = live;
+        this->name_column[live] = this->name_column[position];
+        this->money_column[live] = this->money_column[position];
+        this->datetime_column[live] = this->datetime_column[position];
+        this->position_slots[live] = slot;
+        this->slot_positions[slot] = live;
+        live++;
+    }
+    this->name_column.resize(live);
+    this->money_column.resize(live);
+    this->datetime_column.resize(live);
+    this->position_slots.resize(live);
+    this->tombstones = 0;
+
+    for(auto& [name, position]: this->contract_index){
+        position = new_positions[position];
+    }
+    sorted_index_remap(this->datetime_index, new_positions);
+    sorted_index_remap(this->money_index, new_positions);
+}
+
+bool ContractRecord::rename_contract(Contract contract, const string& new_name){
+
+    size_t position = this->check_contract(contract);
+    this->make_writable();
+
+    Contract potential_duplicate = this->search_contract_duplicate(new_name);
+    if(potential_duplicate.is_valid()){
+        // if the duplicate is the contract itself the name is unchanged and there is nothing to do
+        return potential_duplicate.get_position() == position;
+    }
+
+    this->contract_index.erase(this->name_column[position]);
+    this->name_column[position] = ContractRecord::names.intern(new_name);
+    this->contract_index[this->name_column[position]] = position;
+    return true;
+}
+
+
+void ContractRecord::set_contract_datetime(Contract contract, string& new_datetime_string){
+
+    size_t position = this->check_contract(contract);
+
+    // Check if parsing succeeded, this should never be a problem as new_datetime_string should have been already validated
+    int32_t datetime;
+    if (!parse_datetime_string(new_datetime_string, datetime)) {
+        Contract::logger->logfile << endl << "An error occurred trying to set a contract datetime with datetime string " << new_datetime_string << endl;
+        throw runtime_error("\nAn error occurred trying to set a contract datetime with datetime string " + new_datetime_string  + "\n");
+    }
+
+    this->make_writable();
+    this->build_sorted_indexes();
+    sorted_index_erase(this->datetime_index, this->datetime_column[position], position);
+    this->datetime_column[position] = datetime;
+    sorted_index_insert(this->datetime_index, datetime, position);
+}
+
+
+vector<Contract> ContractRecord::search_contracts_by_datetime(int32_t start_days, int32_t end_days){
+
+    this->build_sorted_indexes();
+    vector<Contract> matching_contracts;
+
+    // binary search for the first contract signed on or after the start day, then the matches are contiguous in the index
+    auto iterator = lower_bound(this->datetime_index.begin(), this->datetime_index.end(), pair<int32_t, size_t>(start_days, 0));
+    for(; (iterator != this->datetime_index.end()) && (iterator->first <= end_days); iterator++){
+        if(this->is_live(iterator->second)){
+            matching_contracts.push_back(this->contract_at(iterator->second));
+        }
+    }
+    return matching_contracts;
+}
+
+
+void ContractRecord::scan_columns(const ContractQuery& query, vector<size_t>& positions) const{
+
+    bool money_filter = (query.lower_money > -numeric_limits<float>::infinity()) || (query.upper_money < numeric_limits<float>::infinity());
+    bool datetime_filter = (query.start_days > numeric_limits<int32_t>::min()) || (query.end_days < numeric_limits<int32_t>::max());
+
+    // streaming pass over the contiguous columns with the vectorized kernels, reading only the columns actually filtered
+    // the tombstones are scanned like the other positions, and removed from the matches afterwards
+    size_t first_match = positions.size();
+    if(money_filter && datetime_filter){
+        filter_money_and_datetime_range(this->money_data(), this->datetime_data(), this->column_size(), query.lower_money, query.upper_money, query.start_days, query.end_days, positions);
+    }
+    else if(money_filter){
+        filter_money_range(this->money_data(), this->column_size(), query.lower_money, query.upper_money, positions);
+    }
+    else if(datetime_filter){
+        filter_datetime_range(this->datetime_data(), this->column_size(), query.start_days, query.end_days, positions);
+    }
+    else{
+        for(size_t i = 0; i < this->column_size(); i++){
+            positions.push_back(i);
+        }
+    }
+    if(this->tombstones != 0){
+        positions.erase(remove_if(positions.begin() + first_match, positions.end(), [this](size_t position){ return !(this->is_live(position)); }), positions.end());
+    }
+}
+
+
+void ContractRecord::search_contracts(const ContractQuery& query, vector<Contract>& matching_contracts){
+
+    this->build_sorted_indexes();
+    const uint32_t* names = this->name_data();
+    const float* money = this->money_data();
+    const int32_t* datetimes = this->datetime_data();
+
+    // the candidates are narrowed down with whichever of the money and datetime indexes yields the shorter range, which costs two binary searches per index
+    auto first_by_money = lower_bound(this->money_index.begin(), this->money_index.end(), pair<float, size_t>(query.lower_money, 0));
+    auto last_by_money = upper_bound(this->money_index.begin(), this->money_index.end(), pair<float, size_t>(query.upper_money, numeric_limits<size_t>::max()));
+    auto first_by_datetime = lower_bound(this->datetime_index.begin(), this->datetime_index.end(), pair<int32_t, size_t>(query.start_days, 0));
+    auto last_by_datetime = upper_bound(this->datetime_index.begin(), this->datetime_index.end(), pair<int32_t, size_t>(query.end_days, numeric_limits<size_t>::max()));
+
+    vector<size_t> candidates;
+    size_t range_by_money = last_by_money - first_by_money;
+    size_t range_by_datetime = last_by_datetime - first_by_datetime;
+
+    // when neither range is selective, jumping around the columns through an index is slower than streaming over them
+    if(min(range_by_money, range_by_datetime) > this->size() / 4){
+        this->scan_columns(query, candidates);
+    }
+    else if(range_by_money <= range_by_datetime){
+        for(auto iterator = first_by_money; iterator < last_by_money; iterator++){
+            size_t position = iterator->second;
+            if((datetimes[position] >= query.start_days) && (datetimes[position] <= query.end_days)){
+                candidates.push_back(position);
+            }
+        }
+    }
     else{
-        ContractRecord::logger->logfile << endl << "An error occurred trying to delete contract " << contract_to_delete->get_name() << endl;
-        throw runtime_error("\nAn error occurred trying to delete contract" + contract_to_delete->get_name() + "\n");
+        for(auto iterator = first_by_datetime; iterator < last_by_datetime; iterator++){
+            size_t position = iterator->second;
+            if((money[position] >= query.lower_money) && (money[position] <= query.upper_money)){
+                candidates.push_back(position);
+            }
+        }
+    }
+    this->remove_deleted(candidates);
+
+    // the name condition is checked last, on the candidates only: either through the ranks of the interned names, computed once for all the records,
+    // or through the names of the names table containing the word
+    if(query.name_ranks != nullptr){
+        for(size_t position: candidates){
+            if((*(query.name_ranks))[names[position]] >= 0){
+                matching_contracts.push_back(this->contract_at(position));
+            }
+        }
+        return;
+    }
+
+    if(query.name_substring.empty()){
+        for(size_t position: candidates){
+            matching_contracts.push_back(this->contract_at(position));
+        }
+        return;
+    }
+
+    vector<size_t> name_positions;
+    this->search_name_positions(to_lowercase(query.name_substring), name_positions);
+    for(size_t position: candidates){
+        if(binary_search(name_positions.begin(), name_positions.end(), position)){
+            matching_contracts.push_back(this->contract_at(position));
+        }
+    }
+}
+
+
+void ContractRecord::search_name_positions(const string& word, vector<size_t>& positions) const{
+
+    positions.clear();
+
+    // checking a name for the word costs far more than looking its id up among the matching ones, so the names are only scanned
+    // when the record is much smaller than the names table, whose matching names may otherwise outnumber the contracts of the record
+    if(8 * this->column_size() < ContractRecord::names.size()){
+        for(size_t position = 0; position < this->column_size(); position++){
+            if(this->is_live(position) && (to_lowercase(string(this->get_name(position))).find(word) != string::npos)){
+                positions.push_back(position);
+            }
+        }
+        return;
+    }
+
+    vector<uint32_t> name_ids;
+    ContractRecord::names.find_names(word, name_ids);
+    const uint32_t* names = this->name_data();
+    for(size_t position = 0; position < this->column_size(); position++){
+        if(this->is_live(position) && binary_search(name_ids.begin(), name_ids.end(), names[position])){
+            positions.push_back(position);
+        }
     }
 }
 
 
+vector<Contract> ContractRecord::search_contracts_by_name(const string& name_substring){
+
+    vector<Contract> matching_contracts;
+    string word = to_lowercase(name_substring);
+
+    // the empty string is contained in any name
+    if(word.empty()){
+        for(size_t i = 0; i < this->column_size(); i++){
+            if(this->is_live(i)){
+                matching_contracts.push_back(this->contract_at(i));
+            }
+        }
+        return matching_contracts;
+    }
+
+    vector<size_t> positions;
+    this->search_name_positions(word, positions);
+
+    // (rank, position) pairs, sorting them puts the most relevant contracts first and keeps the record order among contracts equally relevant
+    vector<pair<int, size_t>> ranked_positions;
+    for(size_t position: positions){
+        ranked_positions.push_back({name_match_rank(to_lowercase(string(this->get_name(position))), word), position});
+    }
+    sort(ranked_positions.begin(), ranked_positions.end());
+
+    for(auto [rank, position]: ranked_positions){
+        matching_contracts.push_back(this->contract_at(position));
+    }
+    return matching_contracts;
+}
+
+
+void ContractRecord::set_contract_money(Contract contract, float new_money){
+
+    size_t position = this->check_contract(contract);
+    this->make_writable();
+    this->build_sorted_indexes();
+
+    sorted_index_erase(this->money_index, this->money_column[position], position);
+    this->money_column[position] = new_money;
+    sorted_index_insert(this->money_index, new_money, position);
+}
+
+
+vector<Contract> ContractRecord::search_contracts_by_money(float lower_money, float upper_money){
+
+    this->build_sorted_indexes();
+    vector<Contract> matching_contracts;
+
+    // binary search for the first contract worth at least the lower bound, then the matches are contiguous in the index
+    auto iterator = lower_bound(this->money_index.begin(), this->money_index.end(), pair<float, size_t>(lower_money, 0));
+    for(; (iterator != this->money_index.end()) && (iterator->first <= upper_money); iterator++){
+        if(this->is_live(iterator->second)){
+            matching_contracts.push_back(this->contract_at(iterator->second));
+        }
+    }
+    return matching_contracts;
+}
+
+
+vector<Contract> ContractRecord::top_contracts_by_money(size_t number_of_contracts){
+
+    this->build_sorted_indexes();
+    vector<Contract> largest_contracts;
+
+    // the largest contracts are at the end of the index
+    for(auto iterator = this->money_index.rbegin(); (iterator != this->money_index.rend()) && (largest_contracts.size() < number_of_contracts); iterator++){
+        if(this->is_live(iterator->second)){
+            largest_contracts.push_back(this->contract_at(iterator->second));
+        }
+    }
+    return largest_contracts;
+}
+
+
 void to_json(json& j, const ContractRecord& contract_record) {
+    json contracts = json::array();
+    for(size_t i = 0; i < contract_record.column_size(); i++){
+        if(!(contract_record.is_live(i))){
+            continue;
+        }
+        contracts.push_back(json{
+            {"name", contract_record.get_name(i)},
+            {"money", contract_record.get_money(i)},
+            {"datetime", format_datetime_days(contract_record.get_datetime(i))}
+        });
+    }
     j = json{
-        {"contract_record", contract_record.contract_record}
+        {"contract_record", contracts}
     };
 }
 
+// keys are written in alphabetical order, as the json library does
+void write_json(JsonWriter& writer, const ContractRecord& contract_record) {
+    writer.begin_object();
+    writer.key("contract_record");
+    writer.begin_array();
+    for(size_t i = 0; i < contract_record.column_size(); i++){
+        if(!(contract_record.is_live(i))){
+            continue;
+        }
+        writer.begin_object();
+        writer.key("datetime");
+        writer.value(format_datetime_days(contract_record.get_datetime(i)));
+        writer.key("money");
+        writer.value(contract_record.get_money(i));
+        writer.key("name");
+        writer.value(contract_record.get_name(i));
+        writer.end_object();
+    }
+    writer.end_array();
+    writer.end_object();
+}
+
 void from_json(const json& j, ContractRecord& contract_record) {
     for (const auto& item : j.at("contract_record")) {
         std::string name;
@@ -253,4 +974,4 @@ void from_json(const json& j, ContractRecord& contract_record) {
         item.at("datetime").get_to(datetime);
         contract_record.add_contract(name, money, datetime);
     }
-}
\ No newline at end of file
+}
@@ -1,29 +1,140 @@
-#pragma once 
+#pragma once
 
 #include <vector>
 #include <ctime>
 #include <sstream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <iomanip>
 #include <tuple>
+#include <unordered_map>
+#include <limits>
+#include <memory>
 #include "utils.hpp"
+#include "JsonWriter.hpp"
+#include "StringArena.hpp"
 
 
 using namespace std;
 
+
+/**
+ * @struct ContractQuery
+ * @brief Conditions that contracts must satisfy to match a query. By default every condition is satisfied by any contract.
+ */
+struct ContractQuery
+{
+    string name_substring = "";                                      // case-insensitive substring of the contract name, empty means any name
+    int32_t start_days = numeric_limits<int32_t>::min();             // first day of the datetime range as a day number, see parse_datetime_string
+    int32_t end_days = numeric_limits<int32_t>::max();               // last day of the datetime range
+    float lower_money = -numeric_limits<float>::infinity();          // lower bound of the money range
+    float upper_money = numeric_limits<float>::infinity();           // upper bound of the money range
+    const vector<int8_t>* name_ranks = nullptr;                      // optional ranks of all the interned names, see NameTable::rank_names. When set, it is used instead of name_substring
+};
+
+
+
+class MappedFile;
+
+/**
+ * @class NameTable
+ * @brief Table of interned strings, used to store each distinct contract name only once.
+ *
+ * Every name is identified by a 32 bit id, which is what contracts store instead of the name itself.
+ * After a snapshot is loaded, the first ids are the names stored in the snapshot, read in place from the mapped file.
+ */
+class NameTable
+{
+    private:
+        // the characters of the names are copied one after the other into an arena, so that adding a name does not allocate it on its own.
+        // The names never move, which keeps the string views used as keys below valid. The name with id i is names[i - mapped_count]
+        StringArena name_storage;
+        vector<string_view> names;
+        unordered_map<string_view, uint32_t> ids;
+
+        // gram index over the lowercase names, from the grams to the sorted ids of the names containing them. It allows searching the names of all the customers at once
+        unordered_map<uint32_t, vector<uint32_t>> grams;
+
+        // string table of a memory mapped snapshot holding the names with ids below mapped_count, see Snapshot.hpp
+        shared_ptr<MappedFile> mapped_file;
+        const uint64_t* mapped_offsets = nullptr;
+        const char* mapped_data = nullptr;
+        uint32_t mapped_count = 0;
+
+        // whether the mapped names are in the ids and grams indexes yet. They are only added when first needed, so that loading a snapshot does not read every name
+        bool mapped_names_indexed = true;
+
+        /** Adds the mapped names to the ids and grams indexes, if not done yet */
+        void index_mapped_names();
+
+        /** Adds a name to the gram index */
+        void index_grams(string_view name, uint32_t id);
+
+    public:
+
+        /** Retrieves the id of a name, adding the name to the table if it is not there yet
+         * @param name: the name to intern
+         * @returns the id of the name
+        */
+        uint32_t intern(string_view name);
+
+        /** Looks up the id of a name, without adding the name to the table
+         * @param name: the name to look for
+         * @param id: set to the id of the name if it is found
+         * @returns false if the name is not in the table, in which case no contract has that name
+        */
+        bool find_id(string_view name, uint32_t& id);
+
+        /** Retrieves the name corresponding to an id
+         * @param id: id returned by intern
+         * @returns the interned name
+        */
+        string_view get_name(uint32_t id) const;
+
+        /** Returns the number of distinct names in the table */
+        size_t size() const;
+
+        /** Ranks all the names of the table against a searched word, using the gram index to only look at the names which may contain it
+         * @param word: the searched word, case-insensitive and not empty
+         * @returns the rank of every name indexed by id, see name_match_rank. Names not containing the word have rank -1
+        */
+        vector<int8_t> rank_names(const string& word);
+
+        /** Finds the names of the table containing a word, using the gram index
+         * @param word: the lowercase word to look for, not empty
+         * @param ids: vector the ids of the matching names are stored in, in increasing order
+        */
+        void find_names(const string& word, vector<uint32_t>& ids);
+
+        /** Makes the names of a snapshot the first entries of the table, without copying them. The table must be empty
+         * @param file: the mapped snapshot, kept mapped as long as the table uses it
+         * @param offsets: the string offsets of the snapshot, of which the first count + 1 are used
+         * @param data: the string data of the snapshot
+         * @param count: number of names
+        */
+        void attach_mapped_names(shared_ptr<MappedFile> file, const uint64_t* offsets, const char* data, uint32_t count);
+};
+
+
+
+class ContractRecord;
+
 /**
  * @class Contract
  * @brief Represents a single contract with a client.
  *
- * Stores the name, amount, and date of the contract.
+ * The name, amount, and date of the contract are stored by the ContractRecord the contract belongs to, one column per field.
+ * A Contract object is a lightweight handle to those columns: its setters go through the record so that the record's indexes stay up to date.
+ * It refers to the contract through a slot of the record and the generation of the slot, so it stays valid whatever other contracts are added or deleted,
+ * and once its own contract is deleted it is no longer valid instead of referring to another contract.
  */
 class Contract
 {
     private:
-        string name;
-        float money;
-        tm datetime;   // to represent datetimes I used the ctime library which provides C-style like structs named tm designed to represent datetimes.
+        ContractRecord* record;
+        uint32_t slot;
+        uint32_t generation;
 
     public:
 
@@ -32,41 +143,53 @@ class Contract
 
 
         /** Default Public constructor for the Contract class.
-         * This is used only when loading data from file.
+         * It creates an invalid view, used to indicate that no contract was found or selected.
          */
         Contract();
 
         /** Public constructor for the Contract class
-         * @param _name: the name of the contract
-         * @param _money: the amount of money assigned to this contract
-         * @param _datetime_string: the string indicating the datetime when the contract was made
+         * @param _record: the record storing the contract
+         * @param _slot: the slot of the contract in the record
+         * @param _generation: the generation of the slot when the handle is created
          */
-        Contract(string& _name, float _money, string& _datetime_string);
+        Contract(ContractRecord* _record, uint32_t _slot, uint32_t _generation);
 
 
         // getters and setters
-        string get_name();
-        float get_money();
-        bool get_valid_datetime();
-        tm get_datetime();
+        string_view get_name() const;
+        float get_money() const;
+        int32_t get_datetime() const;
+        uint32_t get_slot() const;
+        uint32_t get_generation() const;
+        ContractRecord* get_record() const;
 
-        void set_name(string& new_name);
+        /** Retrieves the current position of the contract in the columns of its record, throws if the contract was deleted */
+        size_t get_position() const;
+
+        /** Checks whether the handle refers to an actual contract, which was not deleted */
+        bool is_valid() const;
+
+        /** Renames the contract
+         * @param new_name: the new name of the contract
+         * @returns false if another contract of the same record already has the new name, in which case the contract is not renamed
+        */
+        bool set_name(const string& new_name);
         void set_money(float new_money);
         void set_datetime(string& new_datetime_string);
 
         /** Prints the contract information */
-        void print();
+        void print() const;
 
         /** Less and Greater than operators that compare contracts chronologically depending on their datetime field
+         * @param days: the day number to compare with, see parse_datetime_string
         */
-        bool operator<=(const string datetime_string) const;
-        bool operator>=(const string datetime_string) const;
+        bool operator<=(int32_t days) const;
+        bool operator>=(int32_t days) const;
 
 
         /** Friend functions to manage data saving and loading through the nlohmann json libray: https://github.com/nlohmann/json/releases/latest/download/json.hpp
         */
         friend void to_json(json& j, const Contract& contract);
-        friend void from_json(const json& j, Contract& contract);
 };
 
 
@@ -76,45 +199,246 @@ class Contract
  * @brief Represents the collection of the existing contracts with a specific costumer.
  *
  * Stores the contracts and implements methods to manage the contracts, such as editing, adding or deleting.
+ * A record loaded from a snapshot reads its columns in place from the mapped file, and only copies them into its own vectors when it is first edited.
  */
 class ContractRecord
-{   
+{
     private:
-        // vector of Contract objects
-        vector<Contract> contract_record;
+        // contracts are stored column by column (structure of arrays), so that scans over a single field read contiguous memory.
+        // The contract at a given position is made of the elements at that position in each column.
+        vector<uint32_t> name_column;       // ids of the contract names in the names table
+        vector<float> money_column;
+        vector<int32_t> datetime_column;    // day numbers, see parse_datetime_string
+
+        // stable identity of the contracts, which Contract handles refer to. Each contract has a slot, reused once the contract is deleted
+        // with a new generation. Deleted contracts leave a tombstone at their position until the columns are compacted.
+        // Until a contract is first deleted from the record the tables are empty: the slot of a contract is its position, of generation 0,
+        // so that records never edited that way cost neither memory nor lookups
+        vector<uint32_t> position_slots;    // slot of the contract at each position, tombstone for deleted contracts
+        vector<uint32_t> slot_positions;    // position of the contract of each slot
+        vector<uint32_t> slot_generations;
+        vector<uint32_t> free_slots;
+        size_t tombstones = 0;
+
+        static constexpr uint32_t tombstone = numeric_limits<uint32_t>::max();
+
+        // The indexes below keep their entries for deleted contracts, which the queries skip, until the columns are compacted.
+
+        // hash index from the ids of the contract names (unique within a record) to the positions of the contracts. Only holds the contracts not deleted.
+        // Keys are the interned ids, so looking up a name compares integers and the index holds no copy of the names
+        unordered_map<uint32_t, size_t> contract_index;
+
+        // (datetime, position) pairs sorted chronologically, used to answer datetime range queries with a binary search.
+        // Added contracts are appended, and the index is sorted again by build_sorted_indexes once datetime_index_sorted is false
+        vector<pair<int32_t, size_t>> datetime_index;
+        bool datetime_index_sorted = true;
+
+        // (money, position) pairs sorted by amount, used to answer money range and largest contracts queries. Appended to like the datetime index
+        vector<pair<float, size_t>> money_index;
+        bool money_index_sorted = true;
+
+        // columns of a memory mapped snapshot, used instead of the vectors above while mapped_names is not null (see Snapshot.hpp),
+        // and the positions of the contracts sorted chronologically and by amount, from which the sorted indexes are rebuilt without sorting
+        const uint32_t* mapped_names = nullptr;
+        const float* mapped_money = nullptr;
+        const int32_t* mapped_datetimes = nullptr;
+        const uint32_t* mapped_datetime_order = nullptr;
+        const uint32_t* mapped_money_order = nullptr;
+        size_t mapped_size = 0;
+
+        // whether the sorted indexes and the name index (contract_index) are up to date. Mapped records build them on the first query needing them
+        bool sorted_indexes_built = true;
+        bool name_index_built = true;
+
+        /** Builds the datetime and money indexes of a mapped record from the sorted orders of the snapshot, if not done yet,
+         * and sorts the contracts appended to the indexes out of order since they were last read */
+        void build_sorted_indexes();
+
+        /** Builds the name index of a mapped record, if not done yet */
+        void build_name_index();
+
+        /** Copies the mapped columns into the vectors of the record before it is edited (copy on write), the snapshot itself is never modified */
+        void make_writable();
+
+        // pointers to the first element of each column, mapped or not
+        const uint32_t* name_data() const;
+        const float* money_data() const;
+        const int32_t* datetime_data() const;
+
+        /** Fills the slot tables, empty until the first deletion, with slots equal to the positions */
+        void build_slot_tables();
+
+        /** Number of positions in the columns, tombstones included */
+        size_t column_size() const;
+
+        /** Whether the contract at a position of the columns was not deleted */
+        bool is_live(size_t position) const;
+
+        /** Removes the positions of the deleted contracts from a sorted list of positions */
+        void remove_deleted(vector<size_t>& positions) const;
+
+        /** Handle of the contract at a position of the columns */
+        Contract contract_at(size_t position);
+
+        /** Finds the contracts whose name contains a word. Small records are scanned, the others look up their name ids among the names
+         * of the names table containing the word, found through its gram index
+         * @param word: the lowercase word to look for, not empty
+         * @param positions: vector the positions of the matching contracts are stored in, in increasing order
+        */
+        void search_name_positions(const string& word, vector<size_t>& positions) const;
+
+        /** Checks that a contract handle refers to a contract of this record which was not deleted, throws otherwise
+         * @returns the position of the contract
+        */
+        size_t check_contract(const Contract& contract);
 
     public:
 
-        /** Default Constructor for the class */ 
+        /** Default Constructor for the class */
         ContractRecord();
 
-        // getters and setters
-        vector<Contract>& get_contract_record();
+        static constexpr size_t no_position = numeric_limits<size_t>::max();
+
+        /** Number of contracts, deleted contracts excluded */
+        size_t size() const;
+
+        // getters by position in the columns. Positions run from 0 to size() - 1 only when the record is compacted, see compact
+        string_view get_name(size_t position) const;
+        float get_money(size_t position) const;
+        int32_t get_datetime(size_t position) const;
+        uint32_t get_name_id(size_t position) const;
+
+        /** Retrieves the current position of a contract in the columns
+         * @param contract: handle of the contract
+         * @returns the position of the contract, no_position if it belongs to another record or was deleted
+        */
+        size_t find_position(const Contract& contract) const;
+
+        /** Removes the tombstones of the deleted contracts from the columns and the indexes. Handles stay valid, as only positions change */
+        void compact();
+
+        /** Replaces all the contracts of the record with those of another record. The handles to the replaced contracts become stale,
+         * rather than referring to whichever new contract takes their slot
+         * @param other: the record whose contracts are moved in, left in a moved-from state
+        */
+        void replace_contracts(ContractRecord&& other);
+
+        /** Makes the record a view over contract columns of a mapped snapshot. The record must be empty, and the snapshot must stay mapped as long as the record uses it
+         * @param names: ids of the contract names in the names table
+         * @param money: amounts of money of the contracts
+         * @param datetimes: day numbers of the contracts
+         * @param datetime_order: positions of the contracts sorted chronologically
+         * @param money_order: positions of the contracts sorted by amount of money
+         * @param count: number of contracts
+        */
+        void attach_mapped_columns(const uint32_t* names, const float* money, const int32_t* datetimes, const uint32_t* datetime_order, const uint32_t* money_order, size_t count);
+
+        /** Retrieves the positions of the contracts sorted chronologically and by amount of money, as stored in snapshots
+         * @param datetime_order: vector to store the positions sorted chronologically
+         * @param money_order: vector to store the positions sorted by amount of money. The record must be compacted
+        */
+        void get_sorted_positions(vector<uint32_t>& datetime_order, vector<uint32_t>& money_order);
 
 
         // shared pointer to the Logger object
         static shared_ptr<Logger> logger;
 
+        // table of the interned contract names, shared by all the records so that a name repeated across customers is stored only once
+        static NameTable names;
+
         /** Prints the available information regarding all the customer's contracts */
         void print();
 
-        /** Adds a new contract to the collection of existing contract objects contract_record
+        /** Adds a new contract to the collection of existing contracts
          * @param name: the name of the new contract
          * @param money: the amount of money the new contract is worth
          * @param datetime_string: the date when the contract was signed
+         * @returns false if a contract with the same name already exists, in which case nothing is added
         */
-        void add_contract(string name, float money, string datetime_string);
+        bool add_contract(string_view name, float money, string datetime_string);
 
-        /** Deletes an existing contract
-         * @param contract_to_delete: pointer to the Contract object to delete
+        /** Adds a new contract to the collection of existing contracts
+         * @param name: the name of the new contract
+         * @param money: the amount of money the new contract is worth
+         * @param datetime: the date when the contract was signed as a day number, see parse_datetime_string
+         * @returns false if a contract with the same name already exists, in which case nothing is added
+        */
+        bool add_contract(string_view name, float money, int32_t datetime);
+
+        /** Deletes an existing contract in constant (amortized) time, the handles to the other contracts stay valid
+         * @param contract_to_delete: handle of the contract to delete
         */
-        void delete_contract(Contract* contract_to_delete);
+        void delete_contract(Contract contract_to_delete);
+
+        /** Renames an existing contract keeping the name index up to date
+         * @param contract: view over the contract to rename
+         * @param new_name: the new name of the contract
+         * @returns false if another contract with the new name already exists, in which case the contract is not renamed
+        */
+        bool rename_contract(Contract contract, const string& new_name);
+
+        /** Sets the datetime of an existing contract keeping the datetime index up to date
+         * @param contract: view over the contract to edit
+         * @param new_datetime_string: the new datetime of the contract, already validated
+        */
+        void set_contract_datetime(Contract contract, string& new_datetime_string);
+
+        /** Retrieves the contracts signed within a given period, in chronological order
+         * @param start_days: first day of the period as a day number, see parse_datetime_string
+         * @param end_days: last day of the period as a day number
+         * @returns views over the matching contracts
+        */
+        vector<Contract> search_contracts_by_datetime(int32_t start_days, int32_t end_days);
+
+        /** Sets the money of an existing contract keeping the money index up to date
+         * @param contract: view over the contract to edit
+         * @param new_money: the new amount of money the contract is worth
+        */
+        void set_contract_money(Contract contract, float new_money);
+
+        /** Retrieves the contracts whose name contains a given (sub)string, most relevant first: exact matches, then names starting with the
+         * string, then names with a word starting with it, then any other match. Contracts with the same relevance keep their order in the record
+         * @param name_substring: the string to look for, case-insensitive
+         * @returns views over the matching contracts
+        */
+        vector<Contract> search_contracts_by_name(const string& name_substring);
+
+        /** Retrieves the contracts whose amount of money falls within a given range, in increasing order of money
+         * @param lower_money: lower bound of the range (included)
+         * @param upper_money: upper bound of the range (included)
+         * @returns views over the matching contracts
+        */
+        vector<Contract> search_contracts_by_money(float lower_money, float upper_money);
+
+        /** Retrieves the contracts worth the most money, without sorting the whole record
+         * @param number_of_contracts: how many contracts to retrieve at most
+         * @returns views over the largest contracts, in decreasing order of money
+        */
+        vector<Contract> top_contracts_by_money(size_t number_of_contracts);
+
+        /** Retrieves the contracts satisfying all the conditions of a query
+         * @param query: the conditions on name, datetime and money
+         * @param matching_contracts: vector the views over the matching contracts are appended to
+        */
+        void search_contracts(const ContractQuery& query, vector<Contract>& matching_contracts);
+
+        /** Streams over the money and datetime columns with the vectorized kernels of simd_filters.hpp to find the contracts satisfying both ranges of a query
+         * @param query: the conditions on datetime and money, the name condition is ignored
+         * @param positions: vector the positions of the matching contracts are appended to
+        */
+        void scan_columns(const ContractQuery& query, vector<size_t>& positions) const;
 
         /** Checks if a contract with a given name already exists in the costumer's contract record
          * @param contract_name: name of the contract to look for
-         * @returns pointer to the duplicate existing contract. If no duplicate is found the pointer is nullptr
+         * @returns view over the duplicate existing contract. If no duplicate is found the view is not valid
         */
-        Contract* search_contract_duplicate(string contract_name);
+        Contract search_contract_duplicate(string_view contract_name);
+
+        /** Checks if a contract with a given interned name already exists in the costumer's contract record
+         * @param name_id: id of the name to look for in the names table
+         * @returns view over the duplicate existing contract. If no duplicate is found the view is not valid
+        */
+        Contract search_contract_duplicate(uint32_t name_id);
 
 
         /** Friend functions to manage data saving and loading through the nlohmann json libray: https://github.com/nlohmann/json/releases/latest/download/json.hpp
@@ -122,4 +446,7 @@ class ContractRecord
         friend void to_json(json& j, const ContractRecord& contract_record);
         friend void from_json(const json& j, ContractRecord& contract_record);
 
+        /** Streams the contracts to a JsonWriter, producing the same json as to_json */
+        friend void write_json(JsonWriter& writer, const ContractRecord& contract_record);
+
 };
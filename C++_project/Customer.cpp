@@ -84,6 +84,18 @@ void to_json(json& j, const Customer& customer) {
     };
 }
 
+// keys are written in alphabetical order, as the json library does
+void write_json(JsonWriter& writer, const Customer& customer) {
+    writer.begin_object();
+    writer.key("contract_record");
+    write_json(writer, customer.contract_record);
+    writer.key("name");
+    writer.value(customer.name);
+    writer.key("surname");
+    writer.value(customer.surname);
+    writer.end_object();
+}
+
 void from_json(const json& j, Customer& customer) {
     j.at("name").get_to(customer.name);
     j.at("surname").get_to(customer.surname);
@@ -75,6 +75,9 @@ class Customer: public Person
         friend void to_json(json& j, const Customer& customer);
         friend void from_json(const json& j, Customer& customer);
 
+        /** Streams the customer to a JsonWriter, producing the same json as to_json */
+        friend void write_json(JsonWriter& writer, const Customer& customer);
+
 };
 
 
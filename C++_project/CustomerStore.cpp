@@ -0,0 +1,141 @@
+#include <stdexcept>
+#include "CustomerStore.hpp"
+
+
+using namespace std;
+
+
+
+CustomerStore::iterator CustomerStore::begin()
+{
+    return iterator(this, 0);
+}
+
+CustomerStore::iterator CustomerStore::end()
+{
+    return iterator(this, this->order.size());
+}
+
+CustomerStore::const_iterator CustomerStore::begin() const
+{
+    return const_iterator(this, 0);
+}
+
+CustomerStore::const_iterator CustomerStore::end() const
+{
+    return const_iterator(this, this->order.size());
+}
+
+
+CustomerHandle CustomerStore::insert(Customer&& customer)
+{
+    uint32_t slot;
+    if(!(this->free_slots.empty())){
+        slot = this->free_slots.back();
+        this->free_slots.pop_back();
+    }
+    else{
+        slot = this->slots.size();
+        this->slots.emplace_back();
+    }
+
+    Slot& entry = this->slots[slot];
+    entry.customer.emplace(move(customer));
+    entry.order_position = this->order.size();
+    this->order.push_back(slot);
+    return {slot, entry.generation};
+}
+
+
+void CustomerStore::erase(CustomerHandle handle)
+{
+    if(this->get(handle) == nullptr){
+        throw runtime_error("\nAn error occurred trying to delete a customer which does not exist\n");
+    }
+
+    // the customer is destroyed in place and its slot given a new generation, which makes the handles to it stale
+    Slot& entry = this->slots[handle.slot];
+    entry.customer.reset();
+    entry.generation++;
+    this->free_slots.push_back(handle.slot);
+
+    this->order[entry.order_position] = tombstone;
+    this->tombstones++;
+    if(2 * this->tombstones > this->order.size()){
+        this->compact_order();
+    }
+}
+
+
+void CustomerStore::compact_order()
+{
+    if(this->tombstones == 0){
+        return;
+    }
+
+    size_t live = 0;
+    for(uint32_t slot: this->order){
+        if(slot != tombstone){
+            this->slots[slot].order_position = live;
+            this->order[live++] = slot;
+        }
+    }
+    this->order.resize(live);
+    this->tombstones = 0;
+}
+
+
+Customer* CustomerStore::get(CustomerHandle handle)
+{
+    if((handle.slot >= this->slots.size()) || (this->slots[handle.slot].generation != handle.generation)){
+        return nullptr;
+    }
+    optional<Customer>& customer = this->slots[handle.slot].customer;
+    return customer.has_value() ? &(*customer) : nullptr;
+}
+
+
+Customer& CustomerStore::get_slot(uint32_t slot)
+{
+    return *(this->slots[slot].customer);
+}
+
+
+CustomerHandle CustomerStore::get_handle(uint32_t slot) const
+{
+    return {slot, this->slots[slot].generation};
+}
+
+
+uint32_t CustomerStore::get_order_position(uint32_t slot) const
+{
+    return this->slots[slot].order_position;
+}
+
+
+Customer& CustomerStore::at(size_t position)
+{
+    this->compact_order();
+    if(position >= this->order.size()){
+        throw out_of_range("\nCustomer position " + to_string(position) + " out of range\n");
+    }
+    return this->get_slot(this->order[position]);
+}
+
+
+size_t CustomerStore::size() const
+{
+    return this->order.size() - this->tombstones;
+}
+
+
+bool CustomerStore::empty() const
+{
+    return this->size() == 0;
+}
+
+
+void CustomerStore::reserve(size_t capacity)
+{
+    this->order.reserve(capacity);
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <optional>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include "Customer.hpp"
+
+
+using namespace std;
+
+
+/**
+ * @struct CustomerHandle
+ * @brief Stable reference to a customer of a CustomerStore: the slot holding the customer and the generation of the slot.
+ *
+ * A handle stays valid however many customers are added or deleted. Once its customer is deleted the generation of the slot changes,
+ * so a stale handle is recognized instead of referring to whichever customer reuses the slot.
+ */
+struct CustomerHandle
+{
+    static const uint32_t null_slot = numeric_limits<uint32_t>::max();
+
+    uint32_t slot = null_slot;
+    uint32_t generation = 0;
+
+    /** Whether the handle refers to a customer at all. A handle which is not null may still be stale, see CustomerStore::get */
+    bool is_null() const
+    {
+        return this->slot == null_slot;
+    }
+
+    bool operator==(const CustomerHandle& other) const
+    {
+        return (this->slot == other.slot) && (this->generation == other.generation);
+    }
+};
+
+
+/**
+ * @class CustomerStore
+ * @brief Slot map of customers: constant time insertion, lookup and deletion, with customers that never move in memory.
+ *
+ * Customers live in the slots of a deque, which does not move its elements when it grows, and the slots of deleted customers are reused.
+ * Besides the slots, the store keeps the order of the customers (insertion order, or alphabetical after sort), as a list of slot numbers:
+ * a deleted customer leaves a tombstone in the list, and the list is compacted once tombstones make up half of it.
+ * Slot numbers are stable, so indexes over the customers can store them instead of positions.
+ */
+class CustomerStore
+{
+    private:
+        struct Slot
+        {
+            optional<Customer> customer;
+            uint32_t generation = 0;
+            uint32_t order_position = 0;    // position of the slot in order, while it holds a customer
+        };
+
+        static const uint32_t tombstone = numeric_limits<uint32_t>::max();
+
+        deque<Slot> slots;
+        vector<uint32_t> free_slots;
+
+        // slot of each customer in the order of the store, tombstone where a customer was deleted
+        vector<uint32_t> order;
+        size_t tombstones = 0;
+
+        /** Removes the tombstones from order */
+        void compact_order();
+
+    public:
+
+        /**
+         * @class Iterator
+         * @brief Iterates over the customers in the order of the store, skipping the tombstones.
+         */
+        template<typename StoreType, typename CustomerType>
+        class Iterator
+        {
+            private:
+                StoreType* store;
+                size_t position;
+
+                void skip_tombstones()
+                {
+                    while((this->position < this->store->order.size()) && (this->store->order[this->position] == tombstone)){
+                        this->position++;
+                    }
+                }
+
+            public:
+                Iterator(StoreType* _store, size_t _position)
+                    : store(_store), position(_position)
+                {
+                    this->skip_tombstones();
+                }
+
+                CustomerType& operator*() const
+                {
+                    return *(this->store->slots[this->store->order[this->position]].customer);
+                }
+
+                CustomerType* operator->() const
+                {
+                    return &(**this);
+                }
+
+                Iterator& operator++()
+                {
+                    this->position++;
+                    this->skip_tombstones();
+                    return *this;
+                }
+
+                bool operator!=(const Iterator& other) const
+                {
+                    return this->position != other.position;
+                }
+
+                /** Handle of the customer the iterator is on */
+                CustomerHandle handle() const
+                {
+                    uint32_t slot = this->store->order[this->position];
+                    return {slot, this->store->slots[slot].generation};
+                }
+        };
+
+        typedef Iterator<CustomerStore, Customer> iterator;
+        typedef Iterator<const CustomerStore, const Customer> const_iterator;
+
+        iterator begin();
+        iterator end();
+        const_iterator begin() const;
+        const_iterator end() const;
+
+        /** Adds a customer after the last one
+         * @param customer: the customer to add, left in a moved-from state
+         * @returns the handle of the customer
+         */
+        CustomerHandle insert(Customer&& customer);
+
+        /** Deletes a customer in constant time, the other customers keep their slot and their order
+         * @param handle: handle of the customer, throws if it is stale
+         */
+        void erase(CustomerHandle handle);
+
+        /** Retrieves a customer
+         * @param handle: handle of the customer
+         * @returns pointer to the customer, nullptr if the handle is null or the customer was deleted. The pointer stays valid until the customer is deleted
+         */
+        Customer* get(CustomerHandle handle);
+
+        /** Retrieves the customer held by a slot, which must hold one. Used by the indexes, which store slot numbers */
+        Customer& get_slot(uint32_t slot);
+
+        /** Returns the handle of the customer held by a slot */
+        CustomerHandle get_handle(uint32_t slot) const;
+
+        /** Returns the position of the customer held by a slot in the order of the store, tombstones included. Positions are only comparable with each other */
+        uint32_t get_order_position(uint32_t slot) const;
+
+        /** Returns the customer at a position of the order of the store, compacting the order first if it has tombstones
+         * @param position: position among the customers, from 0 to size() - 1
+         */
+        Customer& at(size_t position);
+
+        size_t size() const;
+        bool empty() const;
+
+        /** Prepares the store for a number of customers */
+        void reserve(size_t capacity);
+
+        /** Sorts the order of the customers, without moving them
+         * @param less: comparison of the slots of two customers
+         */
+        template<typename Compare>
+        void sort(Compare less)
+        {
+            this->compact_order();
+            std::sort(this->order.begin(), this->order.end(), less);
+            for(size_t i = 0; i < this->order.size(); i++){
+                this->slots[this->order[i]].order_position = i;
+            }
+        }
+};
@@ -0,0 +1,390 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Journal.hpp"
+
+
+using namespace std;
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// RECORD ENCODING
+
+
+// size of the file header: magic and generation
+static const size_t journal_header_size = sizeof(journal_magic) + sizeof(uint64_t);
+
+// size of the frame preceding each payload: length and checksum
+static const size_t journal_frame_size = 2 * sizeof(uint32_t);
+
+// larger payloads can only come from a corrupted length
+static const uint32_t journal_max_payload = 1 << 30;
+
+
+// FNV-1a hash of the payload, telling records written completely from torn ones
+static uint32_t journal_checksum(const char* data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < size; i++){
+        hash = (hash ^ uint8_t(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+// the fields stored by each type of record, besides the customer
+static bool has_contract_name(JournalRecordType type)
+{
+    return (type >= JournalRecordType::add_contract);
+}
+
+static bool has_new_value(JournalRecordType type)
+{
+    return (type == JournalRecordType::set_customer_name) || (type == JournalRecordType::set_customer_surname) || (type == JournalRecordType::set_contract_name);
+}
+
+static bool has_money(JournalRecordType type)
+{
+    return (type == JournalRecordType::add_contract) || (type == JournalRecordType::set_contract_money);
+}
+
+static bool has_datetime(JournalRecordType type)
+{
+    return (type == JournalRecordType::add_contract) || (type == JournalRecordType::set_contract_datetime);
+}
+
+
+template<typename T>
+static void append_journal_bytes(vector<char>& buffer, const T& value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static void append_journal_string(vector<char>& buffer, const string& value)
+{
+    append_journal_bytes(buffer, uint32_t(value.size()));
+    buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+/** Appends a record, with its frame, to a buffer */
+static void encode_journal_record(const JournalRecord& record, vector<char>& buffer)
+{
+    size_t frame_start = buffer.size();
+    buffer.resize(frame_start + journal_frame_size);
+
+    buffer.push_back(char(record.type));
+    append_journal_string(buffer, record.customer_name);
+    append_journal_string(buffer, record.customer_surname);
+    if(has_contract_name(record.type)){
+        append_journal_string(buffer, record.contract_name);
+    }
+    if(has_new_value(record.type)){
+        append_journal_string(buffer, record.new_value);
+    }
+    if(has_money(record.type)){
+        append_journal_bytes(buffer, record.money);
+    }
+    if(has_datetime(record.type)){
+        append_journal_bytes(buffer, record.datetime);
+    }
+
+    const char* payload = buffer.data() + frame_start + journal_frame_size;
+    uint32_t payload_size = buffer.size() - frame_start - journal_frame_size;
+    uint32_t checksum = journal_checksum(payload, payload_size);
+    memcpy(buffer.data() + frame_start, &payload_size, sizeof(uint32_t));
+    memcpy(buffer.data() + frame_start + sizeof(uint32_t), &checksum, sizeof(uint32_t));
+}
+
+
+/**
+ * @class JournalPayloadReader
+ * @brief Reads the fields of a record payload, failing instead of reading past its end.
+ */
+class JournalPayloadReader
+{
+    private:
+        const vector<char>& payload;
+        size_t position = 0;
+
+    public:
+        explicit JournalPayloadReader(const vector<char>& _payload)
+            : payload(_payload)
+        {}
+
+        template<typename T>
+        bool read(T& value)
+        {
+            if(this->payload.size() - this->position < sizeof(T)){
+                return false;
+            }
+            memcpy(&value, this->payload.data() + this->position, sizeof(T));
+            this->position += sizeof(T);
+            return true;
+        }
+
+        bool read_string(string& value)
+        {
+            uint32_t length;
+            if(!(this->read(length)) || (this->payload.size() - this->position < length)){
+                return false;
+            }
+            value.assign(this->payload.data() + this->position, length);
+            this->position += length;
+            return true;
+        }
+
+        bool at_end() const
+        {
+            return this->position == this->payload.size();
+        }
+};
+
+/** Decodes a record payload, returns false if it is malformed */
+static bool decode_journal_record(const vector<char>& payload, JournalRecord& record)
+{
+    JournalPayloadReader reader(payload);
+    uint8_t type;
+    if(!(reader.read(type)) || (type < uint8_t(JournalRecordType::add_customer)) || (type > uint8_t(JournalRecordType::set_contract_money))){
+        return false;
+    }
+
+    record = JournalRecord();
+    record.type = JournalRecordType(type);
+    bool valid = reader.read_string(record.customer_name) && reader.read_string(record.customer_surname)
+                && (!(has_contract_name(record.type)) || reader.read_string(record.contract_name))
+                && (!(has_new_value(record.type)) || reader.read_string(record.new_value))
+                && (!(has_money(record.type)) || reader.read(record.money))
+                && (!(has_datetime(record.type)) || reader.read(record.datetime));
+    return valid && reader.at_end();
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// JOURNAL CLASS
+
+
+Journal::Journal(const string& _file_path, uint64_t _generation, uint64_t valid_size, JournalOptions _options)
+    : file_path(_file_path), generation(_generation), options(_options)
+{
+    // appends always go to the end of the file, also after it is truncated
+    this->descriptor = open(this->file_path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if(this->descriptor < 0){
+        throw runtime_error("\nCould not open journal file: " + this->file_path + "\n");
+    }
+
+    if(valid_size < journal_header_size){
+        this->write_header();
+    }
+    else{
+        // a record torn by a crash is cut off, so that the next records follow the last valid one
+        if(ftruncate(this->descriptor, valid_size) != 0){
+            close(this->descriptor);
+            throw runtime_error("\nCould not truncate journal file: " + this->file_path + "\n");
+        }
+        this->file_size = valid_size;
+    }
+
+    this->committer = thread(&Journal::commit_loop, this);
+}
+
+
+Journal::~Journal()
+{
+    {
+        lock_guard<mutex> lock(this->journal_mutex);
+        this->stopping = true;
+    }
+    this->commit_requested.notify_one();
+    this->committer.join();
+    close(this->descriptor);
+}
+
+
+void Journal::write_header()
+{
+    vector<char> header(journal_magic, journal_magic + sizeof(journal_magic));
+    append_journal_bytes(header, this->generation);
+
+    bool written = (ftruncate(this->descriptor, 0) == 0) && (write(this->descriptor, header.data(), header.size()) == ssize_t(header.size()))
+                    && (fsync(this->descriptor) == 0);
+    if(!written){
+        throw runtime_error("\nCould not write journal file: " + this->file_path + "\n");
+    }
+    this->file_size = header.size();
+}
+
+
+void Journal::commit_loop()
+{
+    vector<char> batch;
+    unique_lock<mutex> lock(this->journal_mutex);
+
+    while(true){
+        this->commit_requested.wait(lock, [this]{ return this->stopping || this->flush_requested || !(this->pending.empty()); });
+
+        // give the following edits the chance to join the batch, unless the batch is due already
+        this->commit_requested.wait_for(lock, this->options.commit_interval, [this]{
+            return this->stopping || this->flush_requested || (this->pending.size() >= this->options.commit_size);
+        });
+
+        if(this->pending.empty()){
+            this->flush_requested = false;
+            this->commit_done.notify_all();
+            if(this->stopping){
+                return;
+            }
+            continue;
+        }
+
+        batch.swap(this->pending);
+        uint64_t batch_records = this->appended_records;
+        this->flush_requested = false;
+        lock.unlock();
+
+        // a single write and a single sync for the whole batch
+        string error = "";
+        size_t written = 0;
+        while(written < batch.size()){
+            ssize_t result = write(this->descriptor, batch.data() + written, batch.size() - written);
+            if(result < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                error = string("Could not write journal file: ") + strerror(errno);
+                break;
+            }
+            written += result;
+        }
+        if(error.empty() && (fsync(this->descriptor) != 0)){
+            error = string("Could not sync journal file: ") + strerror(errno);
+        }
+        batch.clear();
+
+        lock.lock();
+        if(!(error.empty())){
+            this->commit_error = error;
+        }
+        this->durable_records = batch_records;
+        this->commit_done.notify_all();
+    }
+}
+
+
+void Journal::check_commit_error()
+{
+    if(!(this->commit_error.empty())){
+        throw runtime_error("\n" + this->commit_error + "\n");
+    }
+}
+
+
+void Journal::append(const JournalRecord& record)
+{
+    vector<char> encoded;
+    encode_journal_record(record, encoded);
+
+    bool commit_due;
+    {
+        lock_guard<mutex> lock(this->journal_mutex);
+        this->check_commit_error();
+        this->pending.insert(this->pending.end(), encoded.begin(), encoded.end());
+        this->appended_records++;
+        this->file_size += encoded.size();
+        commit_due = (this->pending.size() >= this->options.commit_size);
+    }
+    if(commit_due){
+        this->commit_requested.notify_one();
+    }
+}
+
+
+void Journal::flush()
+{
+    unique_lock<mutex> lock(this->journal_mutex);
+    uint64_t target = this->appended_records;
+    if(this->durable_records < target){
+        this->flush_requested = true;
+        this->commit_requested.notify_one();
+        this->commit_done.wait(lock, [&]{ return (this->durable_records >= target) || !(this->commit_error.empty()); });
+    }
+    this->check_commit_error();
+}
+
+
+void Journal::reset(uint64_t new_generation)
+{
+    this->flush();
+
+    lock_guard<mutex> lock(this->journal_mutex);
+    this->generation = new_generation;
+    this->write_header();
+}
+
+
+uint64_t Journal::get_generation() const
+{
+    return this->generation;
+}
+
+
+uint64_t Journal::size()
+{
+    lock_guard<mutex> lock(this->journal_mutex);
+    return this->file_size;
+}
+
+
+uint64_t Journal::replay(const string& file_path, uint64_t generation, const function<void(const JournalRecord&)>& apply)
+{
+    ifstream input_file(file_path, ios::binary);
+    if(!input_file){
+        return 0;
+    }
+
+    // a header torn while the journal was being created holds no record
+    char magic[sizeof(journal_magic)];
+    uint64_t journal_generation;
+    if(!(input_file.read(magic, sizeof(magic))) || !(input_file.read(reinterpret_cast<char*>(&journal_generation), sizeof(journal_generation)))){
+        return 0;
+    }
+    if(!(equal(magic, magic + sizeof(magic), journal_magic))){
+        throw runtime_error("\nInvalid journal file: " + file_path + "\n");
+    }
+
+    // the edits of an older journal are in the snapshot already: the application stopped after writing the snapshot and before emptying the journal
+    if(journal_generation < generation){
+        return 0;
+    }
+    if(journal_generation > generation){
+        throw runtime_error("\nThe journal " + file_path + " follows a snapshot which was not found\n");
+    }
+
+    uint64_t valid_size = journal_header_size;
+    vector<char> payload;
+    JournalRecord record;
+    uint32_t frame[2];
+
+    while(input_file.read(reinterpret_cast<char*>(frame), sizeof(frame))){
+        uint32_t payload_size = frame[0];
+        if(payload_size > journal_max_payload){
+            break;
+        }
+        payload.resize(payload_size);
+        if(!(input_file.read(payload.data(), payload_size)) || (journal_checksum(payload.data(), payload_size) != frame[1])
+            || !(decode_journal_record(payload, record))){
+            break;
+        }
+
+        apply(record);
+        valid_size += journal_frame_size + payload_size;
+    }
+    return valid_size;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+
+using namespace std;
+
+
+/////////////////////////////////////////////////////////////////////
+// Write-ahead journal of the edits made since the last snapshot, see Snapshot.hpp.
+//
+// The file starts with journal_magic and the generation of the snapshot it applies to, followed by records made of:
+// uint32 payload length, uint32 checksum of the payload (FNV-1a), and the payload: a JournalRecordType byte, the name and surname of the customer
+// (uint32 length + bytes each), and the fields of the record type, see JournalRecord.
+// A record whose length or checksum is wrong ends the journal: it can only be the last one, partially written when the application stopped.
+
+
+inline const char journal_magic[8] = {'C', 'R', 'M', 'J', 'R', 'N', 'L', '\0'};
+
+
+/** Kind of edit recorded by a journal record */
+enum class JournalRecordType : uint8_t
+{
+    add_customer = 1,
+    delete_customer,
+    set_customer_name,          // new_value is the new name
+    set_customer_surname,       // new_value is the new surname
+    add_contract,               // contract_name, money and datetime are the fields of the new contract
+    delete_contract,
+    set_contract_name,          // new_value is the new name of the contract
+    set_contract_datetime,
+    set_contract_money
+};
+
+
+/**
+ * @struct JournalRecord
+ * @brief An edit of the customer data. Customers are identified by their name and surname and contracts by their name, as they were before the edit.
+ *
+ * Only the fields used by the type of the record are stored in the journal.
+ */
+struct JournalRecord
+{
+    JournalRecordType type;
+    string customer_name;
+    string customer_surname;
+    string contract_name = "";
+    string new_value = "";
+    float money = 0;
+    int32_t datetime = 0;       // day number, see parse_datetime_string
+};
+
+
+/**
+ * @struct JournalOptions
+ * @brief Group commit policy of the journal.
+ */
+struct JournalOptions
+{
+    // records are written and made durable (fsync) in batches, at most this long after being appended
+    chrono::milliseconds commit_interval = chrono::milliseconds(5);
+
+    // a batch is committed straight away once this many bytes are waiting
+    size_t commit_size = 256 << 10;
+};
+
+
+
+/**
+ * @class Journal
+ * @brief Append-only journal file with group commit.
+ *
+ * Appending a record only encodes it into a buffer. A committer thread writes the buffered records and syncs the file once per batch, so that
+ * a burst of edits costs a single fsync while each edit costs I/O proportional to its record only.
+ * Records appended less than commit_interval before a crash may be lost; flush waits until every appended record is durable.
+ */
+class Journal
+{
+    private:
+        string file_path;
+        int descriptor = -1;
+        uint64_t generation;
+        JournalOptions options;
+
+        mutex journal_mutex;
+        condition_variable commit_requested;
+        condition_variable commit_done;
+
+        // encoded records not written yet
+        vector<char> pending;
+
+        // number of records appended, and of records written and synced
+        uint64_t appended_records = 0;
+        uint64_t durable_records = 0;
+
+        // size of the file once the pending records are written
+        uint64_t file_size = 0;
+
+        bool flush_requested = false;
+        bool stopping = false;
+
+        // error raised by the committer thread, reported by the next append or flush
+        string commit_error = "";
+
+        thread committer;
+
+        /** Body of the committer thread */
+        void commit_loop();
+
+        /** Writes the header of an empty journal, replacing the content of the file */
+        void write_header();
+
+        /** Throws the error of the committer thread, if any. Must be called with the mutex held */
+        void check_commit_error();
+
+    public:
+
+        /** Public constructor for the Journal class, opening a journal for appending
+         * @param _file_path: path of the journal file, created if it does not exist
+         * @param _generation: generation of the snapshot the journal applies to
+         * @param valid_size: number of bytes of the existing file to keep, as returned by replay. Anything after them is cut off,
+         * and with 0 the journal is started anew
+         * @param _options: group commit policy
+         */
+        Journal(const string& _file_path, uint64_t _generation, uint64_t valid_size, JournalOptions _options = JournalOptions());
+
+        /** Destructor, commits the pending records and stops the committer thread */
+        ~Journal();
+
+        Journal(const Journal&) = delete;
+        Journal& operator=(const Journal&) = delete;
+
+        /** Appends a record to the journal. The record is committed by the next batch
+         * @param record: the edit to record
+        */
+        void append(const JournalRecord& record);
+
+        /** Blocks until every record appended so far is written and synced to disk */
+        void flush();
+
+        /** Empties the journal after its edits were saved in a snapshot of a new generation
+         * @param new_generation: generation of the new snapshot
+        */
+        void reset(uint64_t new_generation);
+
+        uint64_t get_generation() const;
+
+        /** Returns the size of the journal file in bytes, including the records not committed yet */
+        uint64_t size();
+
+        /** Reads the records of a journal file and passes them to a function, in order
+         * @param file_path: path of the journal file
+         * @param generation: generation of the snapshot loaded before. A journal of an older generation was already folded into
+         * the snapshot and is ignored, one of a newer generation means that its snapshot is missing and an exception is thrown
+         * @param apply: function applying a record to the customer data
+         * @returns the size of the valid part of the file, to be passed to the constructor. 0 if there is no journal to apply
+        */
+        static uint64_t replay(const string& file_path, uint64_t generation, const function<void(const JournalRecord&)>& apply);
+};
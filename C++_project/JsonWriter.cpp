@@ -0,0 +1,94 @@
+#include <string>
+#include "JsonWriter.hpp"
+
+
+using namespace std;
+
+
+JsonWriter::JsonWriter(ostream& _out, bool _pretty, unsigned int _indent_step)
+    : out(_out), pretty(_pretty), indent_step(_indent_step), serializer(nlohmann::detail::output_adapter<char>(_out), ' ')
+{}
+
+
+void JsonWriter::new_line(size_t depth)
+{
+    this->out.put('\n');
+    for(size_t i = 0; i < depth * this->indent_step; i++){
+        this->out.put(' ');
+    }
+}
+
+
+void JsonWriter::begin_element()
+{
+    // the value of a key follows the key directly
+    if(this->after_key){
+        this->after_key = false;
+        return;
+    }
+
+    // the top level value has no separator
+    if(this->empty_scopes.empty()){
+        return;
+    }
+
+    if(!(this->empty_scopes.back())){
+        this->out.put(',');
+    }
+    this->empty_scopes.back() = false;
+
+    if(this->pretty){
+        this->new_line(this->empty_scopes.size());
+    }
+}
+
+
+void JsonWriter::open_scope(char bracket)
+{
+    this->begin_element();
+    this->out.put(bracket);
+    this->empty_scopes.push_back(true);
+}
+
+
+void JsonWriter::close_scope(char bracket)
+{
+    bool empty = this->empty_scopes.back();
+    this->empty_scopes.pop_back();
+
+    // empty objects and arrays are written on a single line, as {} and []
+    if(this->pretty && !empty){
+        this->new_line(this->empty_scopes.size());
+    }
+    this->out.put(bracket);
+}
+
+
+void JsonWriter::begin_object()
+{
+    this->open_scope('{');
+}
+
+void JsonWriter::end_object()
+{
+    this->close_scope('}');
+}
+
+void JsonWriter::begin_array()
+{
+    this->open_scope('[');
+}
+
+void JsonWriter::end_array()
+{
+    this->close_scope(']');
+}
+
+
+void JsonWriter::key(const string& name)
+{
+    this->begin_element();
+    this->serializer.dump(json(name), false, false, 0);
+    this->out << (this->pretty ? ": " : ":");
+    this->after_key = true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <vector>
+#include "json.hpp"
+
+
+using json = nlohmann::json;
+using namespace std;
+
+
+/**
+ * @class JsonWriter
+ * @brief Writes json text to a stream one token at a time, without building a json object of the whole document.
+ *
+ * The output is byte for byte the one of nlohmann's dump: dump(4) in the pretty mode and dump() in the compact one.
+ * Scalars are written by the library's own serializer, so that numbers and escaped strings are formatted exactly as the library does.
+ * Note that the library writes the keys of an object in alphabetical order, so the callers must do the same to get the same output.
+ */
+class JsonWriter
+{
+    private:
+        ostream& out;
+        bool pretty;
+        unsigned int indent_step;
+
+        // serializer of the json library, which lives in its detail namespace
+        nlohmann::detail::serializer<json> serializer;
+
+        // one entry per open object or array, telling whether it has no element yet
+        vector<bool> empty_scopes;
+
+        // whether the next value completes a key, in which case it needs no separator
+        bool after_key = false;
+
+        /** Writes what goes before an element of the current object or array: a comma after the previous element and, in the pretty mode, a new line and indentation */
+        void begin_element();
+
+        /** Writes a new line and the indentation of the given depth */
+        void new_line(size_t depth);
+
+        void open_scope(char bracket);
+        void close_scope(char bracket);
+
+    public:
+
+        /** Public constructor for the JsonWriter class
+         * @param _out: the stream to write to
+         * @param _pretty: whether to write indented text, as dump(4), or compact text, as dump()
+         * @param _indent_step: number of spaces per indentation level in the pretty mode
+         */
+        JsonWriter(ostream& _out, bool _pretty = true, unsigned int _indent_step = 4);
+
+        void begin_object();
+        void end_object();
+        void begin_array();
+        void end_array();
+
+        /** Writes the key of the next member of the current object */
+        void key(const string& name);
+
+        /** Writes a scalar value (string, number or boolean) as an element of the current array or as the value of the last key */
+        template<typename T>
+        void value(const T& scalar)
+        {
+            this->begin_element();
+            this->serializer.dump(json(scalar), false, false, 0);
+        }
+};
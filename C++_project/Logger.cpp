@@ -0,0 +1,455 @@
+#include <string>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <exception>
+#include <unordered_set>
+#include <cstdlib>
+#include <deque>
+#include "Logger.hpp"
+
+
+using namespace std;
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// LOG EVENTS
+
+
+const char* log_level_name(LogLevel level)
+{
+    switch(level){
+        case LogLevel::trace:
+            return "TRACE";
+        case LogLevel::debug:
+            return "DEBUG";
+        case LogLevel::info:
+            return "INFO";
+        case LogLevel::warn:
+            return "WARN";
+        default:
+            return "ERROR";
+    }
+}
+
+string format_log_message(string_view format_string, const vector<string>& arguments)
+{
+    string message;
+    size_t next_argument = 0;
+    for(size_t i = 0; i < format_string.size(); i++){
+        if((format_string[i] == '{') && (i + 1 < format_string.size()) && (format_string[i + 1] == '}') && (next_argument < arguments.size())){
+            message += arguments[next_argument++];
+            i++;
+        }
+        else{
+            message += format_string[i];
+        }
+    }
+    return message;
+}
+
+
+// registry of the events of all the call sites of the LOG_* macros, the id of an event being its position. A deque so that the definitions never move
+static mutex& events_mutex()
+{
+    static mutex events_mutex;
+    return events_mutex;
+}
+
+static deque<LogEventDefinition>& events()
+{
+    static deque<LogEventDefinition> events;
+    return events;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// LOG RING BUFFER CLASS
+
+
+LogRingBuffer::LogRingBuffer(size_t capacity)
+{
+    size_t rounded_capacity = 1;
+    while(rounded_capacity < capacity){
+        rounded_capacity <<= 1;
+    }
+    this->buffer.resize(rounded_capacity);
+    this->mask = rounded_capacity - 1;
+}
+
+size_t LogRingBuffer::capacity() const
+{
+    return this->buffer.size();
+}
+
+size_t LogRingBuffer::pending() const
+{
+    return this->pushed.load(memory_order_acquire) - this->consumed.load(memory_order_acquire);
+}
+
+size_t LogRingBuffer::total_pushed() const
+{
+    return this->pushed.load(memory_order_acquire);
+}
+
+size_t LogRingBuffer::total_consumed() const
+{
+    return this->consumed.load(memory_order_acquire);
+}
+
+bool LogRingBuffer::try_push(const char* data, size_t size)
+{
+    size_t head = this->pushed.load(memory_order_relaxed);
+    size_t tail = this->consumed.load(memory_order_acquire);
+    if(this->capacity() - (head - tail) < size){
+        return false;
+    }
+
+    // the bytes may wrap around the end of the buffer
+    size_t offset = head & this->mask;
+    size_t first_part = min(size, this->capacity() - offset);
+    memcpy(this->buffer.data() + offset, data, first_part);
+    memcpy(this->buffer.data(), data + first_part, size - first_part);
+
+    // publishing the new counter makes the copied bytes visible to the consumer
+    this->pushed.store(head + size, memory_order_release);
+    return true;
+}
+
+size_t LogRingBuffer::drain(ostream& out)
+{
+    size_t tail = this->consumed.load(memory_order_relaxed);
+    size_t head = this->pushed.load(memory_order_acquire);
+    size_t size = head - tail;
+    if(size == 0){
+        return 0;
+    }
+
+    size_t offset = tail & this->mask;
+    size_t first_part = min(size, this->capacity() - offset);
+    out.write(this->buffer.data() + offset, first_part);
+    out.write(this->buffer.data(), size - first_part);
+
+    // the space is given back to the producer only after the bytes were copied out
+    this->consumed.store(head, memory_order_release);
+    return size;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// LOGGER CLASS
+
+
+// registry of the loggers with a writer thread, flushed by Logger::flush_all
+static mutex& registry_mutex()
+{
+    static mutex registry_mutex;
+    return registry_mutex;
+}
+
+static unordered_set<Logger*>& registry()
+{
+    static unordered_set<Logger*> registry;
+    return registry;
+}
+
+static terminate_handler previous_terminate_handler = nullptr;
+
+static void flush_all_and_terminate()
+{
+    Logger::flush_all();
+    if(previous_terminate_handler != nullptr){
+        previous_terminate_handler();
+    }
+    abort();
+}
+
+
+Logger::Logger()
+    : ring(0), logfile(nullptr)
+{}
+
+
+Logger::Logger(string logfile_name, LoggerOptions _options)
+    : options(_options), ring(max(_options.ring_capacity, 4 * line_buffer_size)), logfile(nullptr)
+{
+    this->file.open(logfile_name, std::ios::out);
+    if (!(this->file)) {
+            throw std::runtime_error("Failed to open logging file: " + logfile_name);
+    }
+
+    // the writer must be woken up before the ring buffer is full, otherwise a blocked producer would wait for the flush interval
+    this->options.flush_size = min(this->options.flush_size, this->ring.capacity() / 2);
+
+    if(this->options.format == LogFormat::binary){
+        this->file.write(log_binary_magic, sizeof(log_binary_magic));
+    }
+
+    this->setp(this->line_buffer, this->line_buffer + line_buffer_size);
+    this->logfile.rdbuf(this);
+    this->writer = thread(&Logger::writer_loop, this);
+
+    // the handlers are installed once, after the registry exists so that it is still alive when they run
+    static bool handlers_installed = [](){
+        registry();
+        atexit(Logger::flush_all);
+        previous_terminate_handler = set_terminate(flush_all_and_terminate);
+        return true;
+    }();
+    (void)handlers_installed;
+
+    lock_guard<mutex> lock(registry_mutex());
+    registry().insert(this);
+}
+
+
+Logger::~Logger()
+{
+    if(!(this->writer.joinable())){
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(registry_mutex());
+        registry().erase(this);
+    }
+
+    this->push_line_buffer();
+    {
+        lock_guard<mutex> lock(this->writer_mutex);
+        this->stopping = true;
+    }
+    this->writer_wakeup.notify_one();
+    this->writer.join();
+    this->file.close();
+}
+
+
+void Logger::push_bytes(const char* data, size_t size)
+{
+    // a record larger than the whole ring buffer could never be pushed
+    if(size > this->ring.capacity()){
+        this->dropped_bytes.fetch_add(size, memory_order_relaxed);
+        return;
+    }
+
+    while(!(this->ring.try_push(data, size))){
+        if(this->options.overflow_policy == LogOverflowPolicy::drop){
+            this->dropped_bytes.fetch_add(size, memory_order_relaxed);
+            break;
+        }
+        // the ring buffer is full, so the writer thread is not waiting for more bytes
+        this->writer_wakeup.notify_one();
+        this_thread::yield();
+    }
+
+    if(this->ring.pending() >= this->options.flush_size){
+        this->writer_wakeup.notify_one();
+    }
+}
+
+
+// nanoseconds since 1970, the timestamp of the binary records
+static int64_t log_timestamp()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+void Logger::push_line_buffer()
+{
+    size_t size = this->pptr() - this->pbase();
+    if(size == 0){
+        return;
+    }
+
+    if(this->options.format == LogFormat::binary){
+        this->record_buffer.clear();
+        this->record_buffer.push_back(char(LogRecordType::text));
+        append_log_bytes(this->record_buffer, log_timestamp());
+        append_log_bytes(this->record_buffer, uint32_t(size));
+        this->record_buffer.insert(this->record_buffer.end(), this->pbase(), this->pptr());
+        this->push_bytes(this->record_buffer.data(), this->record_buffer.size());
+    }
+    else{
+        this->push_bytes(this->pbase(), size);
+    }
+
+    this->at_line_start = (this->pptr()[-1] == '\n');
+    this->setp(this->line_buffer, this->line_buffer + line_buffer_size);
+}
+
+
+void Logger::begin_event_record(uint32_t event_id, uint8_t argument_count)
+{
+    this->record_buffer.clear();
+
+    if((event_id >= this->defined_events.size()) || !(this->defined_events[event_id])){
+        const LogEventDefinition& event = Logger::get_event(event_id);
+        this->record_buffer.push_back(char(LogRecordType::event_definition));
+        append_log_bytes(this->record_buffer, event_id);
+        append_log_bytes(this->record_buffer, uint8_t(event.level));
+        append_log_bytes(this->record_buffer, event.line);
+        append_log_bytes(this->record_buffer, uint16_t(event.file.size()));
+        this->record_buffer.insert(this->record_buffer.end(), event.file.begin(), event.file.end());
+        append_log_bytes(this->record_buffer, uint16_t(event.format_string.size()));
+        this->record_buffer.insert(this->record_buffer.end(), event.format_string.begin(), event.format_string.end());
+
+        if(event_id >= this->defined_events.size()){
+            this->defined_events.resize(event_id + 1, false);
+        }
+        this->defined_events[event_id] = true;
+    }
+
+    this->record_buffer.push_back(char(LogRecordType::event));
+    append_log_bytes(this->record_buffer, log_timestamp());
+    append_log_bytes(this->record_buffer, event_id);
+    append_log_bytes(this->record_buffer, argument_count);
+}
+
+
+void Logger::push_event_text(LogLevel level, uint32_t event_id, const vector<string>& arguments)
+{
+    string line = this->at_line_start ? "" : "\n";
+    line += "[";
+    line += log_level_name(level);
+    line += "] ";
+    line += format_log_message(Logger::get_event(event_id).format_string, arguments);
+    line += "\n";
+
+    this->push_bytes(line.data(), line.size());
+    this->at_line_start = true;
+}
+
+
+Logger::int_type Logger::overflow(int_type character)
+{
+    this->push_line_buffer();
+    if(!(traits_type::eq_int_type(character, traits_type::eof()))){
+        *(this->pptr()) = traits_type::to_char_type(character);
+        this->pbump(1);
+    }
+    return traits_type::not_eof(character);
+}
+
+
+int Logger::sync()
+{
+    this->push_line_buffer();
+    return 0;
+}
+
+
+void Logger::write_pending()
+{
+    size_t written = this->ring.drain(this->file);
+
+    size_t dropped = this->dropped_bytes.load(memory_order_relaxed);
+    if(dropped > this->reported_dropped_bytes){
+        string notice = "\n[" + to_string(dropped - this->reported_dropped_bytes) + " bytes of log records dropped: the log buffer was full]\n";
+        if(this->options.format == LogFormat::binary){
+            // a text record like the free text of push_line_buffer, built apart since record_buffer belongs to the producer
+            vector<char> record;
+            record.push_back(char(LogRecordType::text));
+            append_log_bytes(record, log_timestamp());
+            append_log_bytes(record, uint32_t(notice.size()));
+            record.insert(record.end(), notice.begin(), notice.end());
+            this->file.write(record.data(), record.size());
+        }
+        else{
+            this->file << notice;
+        }
+        this->file.flush();
+        this->reported_dropped_bytes = dropped;
+    }
+
+    // a single system call for the whole batch
+    if(written > 0){
+        this->file.flush();
+        this->written_bytes.fetch_add(written, memory_order_release);
+    }
+}
+
+
+void Logger::writer_loop()
+{
+    unique_lock<mutex> lock(this->writer_mutex);
+    while(true){
+        // the producer does not take the mutex to wake the writer up, so a wake up can be missed: the interval bounds how late the bytes are written in that case
+        this->writer_wakeup.wait_for(lock, this->options.flush_interval, [this](){
+            return this->stopping || this->flush_requested || (this->ring.pending() >= this->options.flush_size);
+        });
+        bool stop = this->stopping;
+        this->flush_requested = false;
+
+        lock.unlock();
+        this->write_pending();
+        lock.lock();
+
+        // everything pushed before stopping was set has been written by now
+        if(stop){
+            return;
+        }
+    }
+}
+
+
+void Logger::flush()
+{
+    if(!(this->writer.joinable())){
+        return;
+    }
+
+    this->push_line_buffer();
+    size_t target = this->ring.total_pushed();
+    {
+        lock_guard<mutex> lock(this->writer_mutex);
+        this->flush_requested = true;
+    }
+    this->writer_wakeup.notify_one();
+
+    while(this->written_bytes.load(memory_order_acquire) < target){
+        this_thread::yield();
+    }
+}
+
+
+uint32_t Logger::register_event(LogLevel level, const char* file, uint32_t line, const char* format_string)
+{
+    lock_guard<mutex> lock(events_mutex());
+
+    // only the file name is kept, not the path it was compiled from
+    string_view file_name(file);
+    size_t separator = file_name.find_last_of("/\\");
+    if(separator != string_view::npos){
+        file_name.remove_prefix(separator + 1);
+    }
+
+    events().push_back({level, string(file_name), line, format_string});
+    return events().size() - 1;
+}
+
+
+const LogEventDefinition& Logger::get_event(uint32_t event_id)
+{
+    lock_guard<mutex> lock(events_mutex());
+    return events()[event_id];
+}
+
+
+void Logger::flush_all()
+{
+    lock_guard<mutex> lock(registry_mutex());
+    for(Logger* logger: registry()){
+        logger->flush();
+    }
+}
+
+
+size_t Logger::get_dropped_bytes() const
+{
+    return this->dropped_bytes.load(memory_order_relaxed);
+}
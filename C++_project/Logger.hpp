@@ -0,0 +1,382 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <fstream>
+#include <streambuf>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <string_view>
+#include <sstream>
+
+
+using namespace std;
+
+
+/** Severity of a log event */
+enum class LogLevel : uint8_t
+{
+    trace,      // fine grained steps, such as the validation of every user input
+    debug,
+    info,
+    warn,
+    error
+};
+
+/** Returns the name of a level as written in the log ("TRACE", "DEBUG", ...) */
+const char* log_level_name(LogLevel level);
+
+
+// Events below this level are compiled out by the LOG_* macros: neither their arguments are evaluated nor any code is generated for them.
+// It can be set when compiling (e.g. -DLOG_LEVEL_THRESHOLD=3 to keep only warnings and errors), by default release builds (NDEBUG) keep info and above
+#ifndef LOG_LEVEL_THRESHOLD
+#ifdef NDEBUG
+#define LOG_LEVEL_THRESHOLD 2
+#else
+#define LOG_LEVEL_THRESHOLD 0
+#endif
+#endif
+
+/** Whether the events of a level are kept by the LOG_* macros, see LOG_LEVEL_THRESHOLD. The levels are compared as enum values, since comparing
+ * their unsigned underlying values with a threshold of 0 would warn that the comparison is always true
+ */
+constexpr bool log_level_enabled(LogLevel level)
+{
+    return level >= LogLevel(LOG_LEVEL_THRESHOLD);
+}
+
+/** Logs an event. The event is registered once per call site, the first time it is reached, so that binary logs only store its id.
+ * @param logger: shared pointer to the Logger
+ * @param level: a LogLevel value
+ * @param format_string: string literal where every {} is replaced by the next argument
+ * @param ...: arguments of the event (integers, floating point numbers, booleans or strings)
+*/
+#define LOG_EVENT(logger, level, format_string, ...)                                                                   \
+    do {                                                                                                                \
+        if constexpr (log_level_enabled(level)) {                                                                       \
+            static const uint32_t log_event_id = Logger::register_event(level, __FILE__, __LINE__, format_string);     \
+            (logger)->log_event(level, log_event_id __VA_OPT__(,) __VA_ARGS__);                                         \
+        }                                                                                                               \
+    } while(0)
+
+#define LOG_TRACE(logger, format_string, ...) LOG_EVENT(logger, LogLevel::trace, format_string __VA_OPT__(,) __VA_ARGS__)
+#define LOG_DEBUG(logger, format_string, ...) LOG_EVENT(logger, LogLevel::debug, format_string __VA_OPT__(,) __VA_ARGS__)
+#define LOG_INFO(logger, format_string, ...) LOG_EVENT(logger, LogLevel::info, format_string __VA_OPT__(,) __VA_ARGS__)
+#define LOG_WARN(logger, format_string, ...) LOG_EVENT(logger, LogLevel::warn, format_string __VA_OPT__(,) __VA_ARGS__)
+#define LOG_ERROR(logger, format_string, ...) LOG_EVENT(logger, LogLevel::error, format_string __VA_OPT__(,) __VA_ARGS__)
+
+
+/** Format of the log file */
+enum class LogFormat
+{
+    text,       // human readable lines
+    binary      // compact records, turned back into text by the log_decoder tool
+};
+
+
+/////////////////////////////////////////////////////////////////////
+// Binary log format. The file starts with log_binary_magic, followed by records made of a LogRecordType byte and:
+// - event_definition: uint32 event id, uint8 level, uint32 line, uint16 length + bytes of the file name, uint16 length + bytes of the format string.
+//   It is written before the first occurrence of each event, so that a file can be decoded on its own
+// - event: int64 timestamp (nanoseconds since 1970), uint32 event id, uint8 number of arguments, then each argument as a LogArgumentType byte and its value
+//   (int64, uint64, double, uint8 for booleans, uint32 length + bytes for strings)
+// - text: int64 timestamp, uint32 length + bytes of text written through the logfile stream
+// Numbers are stored in the byte order of the machine writing the log.
+
+inline const char log_binary_magic[8] = {'C', 'R', 'M', 'L', 'O', 'G', '0', '1'};
+
+enum class LogRecordType : uint8_t
+{
+    event_definition = 1,
+    event = 2,
+    text = 3
+};
+
+enum class LogArgumentType : uint8_t
+{
+    signed_integer = 1,
+    unsigned_integer = 2,
+    floating_point = 3,
+    string = 4,
+    boolean = 5
+};
+
+/** Appends the bytes of a value to a binary record */
+template<typename T>
+inline void append_log_bytes(vector<char>& record, const T& value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    record.insert(record.end(), bytes, bytes + sizeof(T));
+}
+
+/** Appends an argument of an event to a binary record, preceded by its type */
+template<typename T>
+inline void append_log_argument(vector<char>& record, const T& argument)
+{
+    if constexpr (is_same_v<T, bool>){
+        record.push_back(char(LogArgumentType::boolean));
+        record.push_back(char(argument));
+    }
+    else if constexpr (is_integral_v<T> && is_signed_v<T>){
+        record.push_back(char(LogArgumentType::signed_integer));
+        append_log_bytes(record, int64_t(argument));
+    }
+    else if constexpr (is_integral_v<T>){
+        record.push_back(char(LogArgumentType::unsigned_integer));
+        append_log_bytes(record, uint64_t(argument));
+    }
+    else if constexpr (is_floating_point_v<T>){
+        record.push_back(char(LogArgumentType::floating_point));
+        append_log_bytes(record, double(argument));
+    }
+    else{
+        string_view text(argument);
+        record.push_back(char(LogArgumentType::string));
+        append_log_bytes(record, uint32_t(text.size()));
+        record.insert(record.end(), text.begin(), text.end());
+    }
+}
+
+/** Converts an argument of an event to text, the same way the log_decoder tool does */
+template<typename T>
+inline string log_argument_text(const T& argument)
+{
+    if constexpr (is_same_v<T, bool>){
+        return argument ? "true" : "false";
+    }
+    else if constexpr (is_integral_v<T>){
+        return to_string(argument);
+    }
+    else if constexpr (is_floating_point_v<T>){
+        ostringstream oss;
+        oss << double(argument);
+        return oss.str();
+    }
+    else{
+        return string(string_view(argument));
+    }
+}
+
+/** Builds the message of an event, replacing every {} of the format string with the next argument
+ * @param format_string: the format string of the event
+ * @param arguments: the arguments already converted to text
+ * @returns the message
+*/
+string format_log_message(string_view format_string, const vector<string>& arguments);
+
+
+/** What the logger does when the application produces log records faster than the writer thread can write them and the ring buffer is full */
+enum class LogOverflowPolicy
+{
+    block,      // wait for the writer thread to make room, nothing is lost
+    drop        // discard the records that do not fit, the number of bytes dropped is reported in the log file
+};
+
+
+/**
+ * @struct LoggerOptions
+ * @brief Tuning parameters of the Logger: size of the ring buffer and flush policy.
+ */
+struct LoggerOptions
+{
+    size_t ring_capacity = 1 << 20;                                     // bytes of the ring buffer between the application and the writer thread (rounded up to a power of two)
+    size_t flush_size = 64 << 10;                                       // the writer thread is woken up as soon as this many bytes are waiting to be written
+    chrono::milliseconds flush_interval = chrono::milliseconds(200);    // the bytes waiting are written at least this often
+    LogOverflowPolicy overflow_policy = LogOverflowPolicy::block;
+    LogFormat format = LogFormat::text;
+    LogLevel level = LogLevel::trace;                                   // events below this level are skipped at runtime, see also LOG_LEVEL_THRESHOLD
+};
+
+
+/**
+ * @struct LogEventDefinition
+ * @brief Static information about a log event, registered once per call site of the LOG_* macros
+ */
+struct LogEventDefinition
+{
+    LogLevel level;
+    string file;
+    uint32_t line;
+    string format_string;
+};
+
+
+
+/**
+ * @class LogRingBuffer
+ * @brief Lock-free bounded byte queue with a single producer (the application) and a single consumer (the writer thread).
+ *
+ * The producer and the consumer only share two monotonically increasing counters, the number of bytes pushed and the number of bytes consumed,
+ * so that neither of them ever waits for the other while holding a lock.
+ */
+class LogRingBuffer
+{
+    private:
+        vector<char> buffer;
+        size_t mask;                    // capacity - 1, the capacity being a power of two
+
+        // the counters are kept on separate cache lines, as each of them is written by a different thread
+        alignas(64) atomic<size_t> pushed{0};
+        alignas(64) atomic<size_t> consumed{0};
+
+    public:
+
+        /** Public constructor for the LogRingBuffer class
+         * @param capacity: minimum number of bytes the buffer can hold
+         */
+        explicit LogRingBuffer(size_t capacity);
+
+        size_t capacity() const;
+
+        /** Returns the number of bytes pushed and not consumed yet */
+        size_t pending() const;
+
+        /** Returns the number of bytes pushed since the creation of the buffer */
+        size_t total_pushed() const;
+
+        /** Returns the number of bytes consumed since the creation of the buffer */
+        size_t total_consumed() const;
+
+        /** Appends bytes to the buffer, either all of them or none. Only called by the producer
+         * @param data: pointer to the first byte
+         * @param size: number of bytes
+         * @returns false if there is not enough room for all the bytes
+        */
+        bool try_push(const char* data, size_t size);
+
+        /** Writes all the pending bytes to a stream and consumes them. Only called by the consumer
+         * @param out: the stream to write to
+         * @returns the number of bytes written
+        */
+        size_t drain(ostream& out);
+};
+
+
+
+/**
+ * @class Logger
+ * @brief Implements a logger that keeps track of the actions executed by the CRM application
+ *
+ * The log is written through the logfile stream as before. The text is collected in a small local buffer and, whenever the stream is flushed (e.g. by endl),
+ * handed over to a lock-free ring buffer without any system call. A background writer thread drains the ring buffer into the file in batches,
+ * every flush_interval or as soon as flush_size bytes are waiting, and once more when the logger is destroyed.
+ * Besides the free text written to logfile, events with a level can be logged through the LOG_* macros. In the binary format they are stored as compact records
+ * (timestamp, event id and arguments) and formatted only when the log is decoded.
+ * The logger must only be written by one thread at a time.
+ */
+class Logger : private streambuf
+{
+    private:
+        static const size_t line_buffer_size = 4096;
+
+        LoggerOptions options;
+        LogRingBuffer ring;
+        char line_buffer[line_buffer_size];     // put area of the logfile stream
+
+        ofstream file;                          // only accessed by the writer thread once it is started
+        thread writer;
+        mutex writer_mutex;
+        condition_variable writer_wakeup;
+        bool stopping = false;                  // protected by writer_mutex
+        bool flush_requested = false;           // protected by writer_mutex
+        atomic<size_t> dropped_bytes{0};
+        size_t reported_dropped_bytes = 0;     // dropped bytes already reported in the file, only accessed by the writer thread
+        atomic<size_t> written_bytes{0};       // bytes of the ring buffer written to the file and flushed
+
+        // state of the producer side
+        vector<char> record_buffer;             // binary record being built
+        vector<bool> defined_events;            // events whose definition was already written to the binary log
+        bool at_line_start = true;              // whether the last text handed over ended a line
+
+        /** Hands bytes over to the ring buffer, all of them or none, applying the overflow policy if it is full */
+        void push_bytes(const char* data, size_t size);
+
+        /** Hands the contents of the local buffer over to the ring buffer, as a text record in the binary format */
+        void push_line_buffer();
+
+        /** Starts a binary event record in record_buffer, preceded by the definition of the event if it was not written yet */
+        void begin_event_record(uint32_t event_id, uint8_t argument_count);
+
+        /** Writes an event in the text format */
+        void push_event_text(LogLevel level, uint32_t event_id, const vector<string>& arguments);
+
+        /** Writes the pending bytes to the file, called by the writer thread only */
+        void write_pending();
+
+        /** Body of the writer thread */
+        void writer_loop();
+
+        // streambuf interface, called by the logfile stream
+        int_type overflow(int_type character) override;
+        int sync() override;
+
+    public:
+        ostream logfile;
+
+        /** Default constructor, the resulting logger discards everything written to it */
+        Logger();
+
+        /** Public constructor for the Logger class
+         * @param logfile_name: path of the log file, which is truncated
+         * @param _options: size of the ring buffer and flush policy
+         */
+        Logger(string logfile_name, LoggerOptions _options = LoggerOptions());
+
+        /** Destructor, writes all the pending records and stops the writer thread */
+        ~Logger();
+
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        /** Blocks until everything written to logfile so far is in the file */
+        void flush();
+
+        /** Flushes all the existing loggers. Called when the application exits without destroying them (exit, uncaught exceptions),
+         * so that the records written just before are not lost
+        */
+        static void flush_all();
+
+        /** Returns the number of bytes discarded so far because the ring buffer was full, only with the drop overflow policy */
+        size_t get_dropped_bytes() const;
+
+        /** Registers a log event, called once per call site by the LOG_* macros
+         * @returns the id of the event
+        */
+        static uint32_t register_event(LogLevel level, const char* file, uint32_t line, const char* format_string);
+
+        /** Retrieves the definition of a registered event, definitions never move once registered */
+        static const LogEventDefinition& get_event(uint32_t event_id);
+
+        /** Logs an occurrence of a registered event, use the LOG_* macros rather than calling this directly
+         * @param level: level of the event
+         * @param event_id: id returned by register_event
+         * @param arguments: arguments replacing the {} of the format string
+        */
+        template<typename... Args>
+        void log_event(LogLevel level, uint32_t event_id, const Args&... arguments)
+        {
+            if(!(this->writer.joinable()) || (level < this->options.level)){
+                return;
+            }
+
+            // the text written to logfile so far goes first, so that the order is preserved
+            this->push_line_buffer();
+
+            if(this->options.format == LogFormat::text){
+                this->push_event_text(level, event_id, vector<string>{log_argument_text(arguments)...});
+                return;
+            }
+
+            this->begin_event_record(event_id, uint8_t(sizeof...(Args)));
+            (append_log_argument(this->record_buffer, arguments), ...);
+            this->push_bytes(this->record_buffer.data(), this->record_buffer.size());
+        }
+};
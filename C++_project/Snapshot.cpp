@@ -0,0 +1,134 @@
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Snapshot.hpp"
+
+
+using namespace std;
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// MAPPED FILE CLASS
+
+
+MappedFile::MappedFile(const string& file_path)
+{
+    int descriptor = open(file_path.c_str(), O_RDONLY);
+    if(descriptor < 0){
+        throw runtime_error("\nCould not open snapshot file: " + file_path + "\n");
+    }
+
+    struct stat file_status;
+    if((fstat(descriptor, &file_status) != 0) || (file_status.st_size == 0)){
+        close(descriptor);
+        throw runtime_error("\nCould not read snapshot file: " + file_path + "\n");
+    }
+    this->size = file_status.st_size;
+
+    // private mapping: the snapshot is never written through the mapping, edits are applied to copies of the columns
+    void* mapping = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if(mapping == MAP_FAILED){
+        throw runtime_error("\nCould not map snapshot file: " + file_path + "\n");
+    }
+    this->data = static_cast<const char*>(mapping);
+}
+
+MappedFile::~MappedFile()
+{
+    if(this->data != nullptr){
+        munmap(const_cast<char*>(this->data), this->size);
+    }
+}
+
+const char* MappedFile::get_data() const
+{
+    return this->data;
+}
+
+size_t MappedFile::get_size() const
+{
+    return this->size;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// SNAPSHOT HEADER
+
+
+// checks that an array of a given number of elements starting at a given offset lies within the file and is aligned
+static bool section_fits(const SnapshotHeader& header, uint64_t offset, uint64_t count, uint64_t element_size)
+{
+    return (offset % snapshot_alignment == 0) && (offset <= header.file_size) && (count <= (header.file_size - offset) / element_size);
+}
+
+
+const SnapshotHeader& read_snapshot_header(const MappedFile& file)
+{
+    if(file.get_size() < sizeof(SnapshotHeader)){
+        throw runtime_error("\nInvalid snapshot file: too short\n");
+    }
+
+    const SnapshotHeader& header = *(file.at<SnapshotHeader>(0));
+    if(!(equal(header.magic, header.magic + sizeof(snapshot_magic), snapshot_magic))){
+        throw runtime_error("\nInvalid snapshot file: wrong magic number\n");
+    }
+    if((header.version != snapshot_version) || (header.header_size != sizeof(SnapshotHeader))){
+        throw runtime_error("\nUnsupported snapshot version " + to_string(header.version) + "\n");
+    }
+    if(header.file_size != file.get_size()){
+        throw runtime_error("\nInvalid snapshot file: truncated\n");
+    }
+
+    bool valid = (header.contract_name_count + 2 * header.customer_count == header.string_count)
+                && (header.string_count < numeric_limits<uint32_t>::max())
+                && section_fits(header, header.string_offsets_offset, header.string_count + 1, sizeof(uint64_t))
+                && section_fits(header, header.string_data_offset, header.string_bytes, 1)
+                && section_fits(header, header.customers_offset, header.customer_count, sizeof(SnapshotCustomer))
+                && section_fits(header, header.name_column_offset, header.contract_count, sizeof(uint32_t))
+                && section_fits(header, header.money_column_offset, header.contract_count, sizeof(float))
+                && section_fits(header, header.datetime_column_offset, header.contract_count, sizeof(int32_t))
+                && section_fits(header, header.datetime_order_offset, header.contract_count, sizeof(uint32_t))
+                && section_fits(header, header.money_order_offset, header.contract_count, sizeof(uint32_t));
+    if(!valid){
+        throw runtime_error("\nInvalid snapshot file: corrupted header\n");
+    }
+    return header;
+}
+
+
+bool is_snapshot_file(const string& file_path)
+{
+    ifstream input_file(file_path, ios::binary);
+    char magic[sizeof(snapshot_magic)];
+    return input_file.read(magic, sizeof(magic)) && equal(magic, magic + sizeof(magic), snapshot_magic);
+}
+
+
+uint64_t read_snapshot_generation(const string& file_path)
+{
+    MappedFile file(file_path);
+    return read_snapshot_header(file).generation;
+}
+
+
+void sync_path(const string& path)
+{
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if(descriptor < 0){
+        throw runtime_error("\nCould not open " + path + "\n");
+    }
+    bool synced = (fsync(descriptor) == 0);
+    close(descriptor);
+    if(!synced){
+        throw runtime_error("\nCould not sync " + path + " to disk\n");
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+
+using namespace std;
+
+
+/////////////////////////////////////////////////////////////////////
+// Binary snapshot of the CRM data. Unlike the json files, a snapshot is memory mapped when loaded and its contract columns are used in place,
+// so that loading takes a time proportional to the number of customers rather than to the number of contracts.
+//
+// Layout (numbers in the byte order of the machine writing the snapshot, every section aligned to snapshot_alignment bytes):
+// - SnapshotHeader
+// - string offsets: uint64[string_count + 1], string i being the bytes [offsets[i], offsets[i + 1]) of the string data.
+//   The first contract_name_count strings are the contract names, with the ids they have in the names table, followed by the names and surnames of the customers
+// - string data: the bytes of all the strings
+// - customers: SnapshotCustomer[customer_count]
+// - contract columns, each with contract_count elements, the contracts of each customer being contiguous:
+//   name ids (uint32), money (float), datetimes (int32 day numbers), and for each customer the positions of its contracts (uint32)
+//   sorted chronologically and by amount of money, so that the sorted indexes can be rebuilt without sorting
+
+
+inline const char snapshot_magic[8] = {'C', 'R', 'M', 'S', 'N', 'A', 'P', '\0'};
+inline const uint32_t snapshot_version = 1;
+inline const size_t snapshot_alignment = 64;
+
+// extension of the files saved as snapshots by the CLI, any other file is saved as json
+inline const string snapshot_extension = ".snapshot";
+
+
+/**
+ * @struct SnapshotHeader
+ * @brief First bytes of a snapshot file: format version, sizes, and positions of the sections (in bytes from the start of the file)
+ */
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t generation;            // incremented by each compaction of the journal into a snapshot, see Journal.hpp
+    uint64_t customer_count;
+    uint64_t contract_count;
+    uint64_t contract_name_count;
+    uint64_t string_count;
+    uint64_t string_bytes;
+    uint64_t string_offsets_offset;
+    uint64_t string_data_offset;
+    uint64_t customers_offset;
+    uint64_t name_column_offset;
+    uint64_t money_column_offset;
+    uint64_t datetime_column_offset;
+    uint64_t datetime_order_offset;
+    uint64_t money_order_offset;
+    uint64_t file_size;
+};
+
+
+/**
+ * @struct SnapshotCustomer
+ * @brief Entry of the customers table of a snapshot
+ */
+struct SnapshotCustomer
+{
+    uint32_t name_id;               // string holding the name of the customer
+    uint32_t surname_id;            // string holding the surname of the customer
+    uint64_t first_contract;        // position of the first contract of the customer in the contract columns
+    uint64_t contract_count;        // number of contracts of the customer
+};
+
+
+/** Rounds a position up to the alignment of the snapshot sections */
+inline uint64_t snapshot_align(uint64_t position)
+{
+    return (position + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment;
+}
+
+
+
+/**
+ * @class MappedFile
+ * @brief Read-only memory mapping of a whole file, unmapped when the object is destroyed.
+ *
+ * The pages are loaded lazily by the operating system when they are first read, and shared with the page cache.
+ */
+class MappedFile
+{
+    private:
+        const char* data = nullptr;
+        size_t size = 0;
+
+    public:
+
+        /** Public constructor for the MappedFile class, throws if the file cannot be mapped
+         * @param file_path: path of the file to map
+         */
+        explicit MappedFile(const string& file_path);
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* get_data() const;
+        size_t get_size() const;
+
+        /** Returns a pointer to an array stored at a given position of the file
+         * @param offset: position of the array in bytes from the start of the file
+         * @returns the pointer to the first element
+        */
+        template<typename T>
+        const T* at(uint64_t offset) const
+        {
+            return reinterpret_cast<const T*>(this->data + offset);
+        }
+};
+
+
+/** Checks that the header of a mapped file describes a valid snapshot whose sections all lie within the file, throws otherwise
+ * @param file: the mapped file
+ * @returns the header
+*/
+const SnapshotHeader& read_snapshot_header(const MappedFile& file);
+
+/** Checks whether a file starts as a snapshot does, used to tell snapshots and json files apart
+ * @param file_path: path of the file
+*/
+bool is_snapshot_file(const string& file_path);
+
+/** Reads the generation of a snapshot file, throws if the file is not a valid snapshot
+ * @param file_path: path of the file
+*/
+uint64_t read_snapshot_generation(const string& file_path);
+
+/** Forces the content of a file, or the entries of a directory, to be written to disk (fsync), throws on failure
+ * @param path: path of the file or directory
+*/
+void sync_path(const string& path);
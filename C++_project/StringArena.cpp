@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <cstring>
+#include "StringArena.hpp"
+
+
+using namespace std;
+
+
+
+StringArena::StringArena(size_t _block_size)
+    : block_size(max<size_t>(_block_size, 1))
+{}
+
+
+StringArena::StringArena(StringArena&& other) noexcept
+    : blocks(move(other.blocks)), block_size(other.block_size), next(other.next), remaining(other.remaining), stored_bytes(other.stored_bytes)
+{
+    other.blocks.clear();
+    other.next = nullptr;
+    other.remaining = 0;
+    other.stored_bytes = 0;
+}
+
+
+StringArena& StringArena::operator=(StringArena&& other) noexcept
+{
+    if(this != &other){
+        this->blocks = move(other.blocks);
+        this->block_size = other.block_size;
+        this->next = other.next;
+        this->remaining = other.remaining;
+        this->stored_bytes = other.stored_bytes;
+        other.blocks.clear();
+        other.next = nullptr;
+        other.remaining = 0;
+        other.stored_bytes = 0;
+    }
+    return *this;
+}
+
+
+void StringArena::add_block(size_t minimum_size)
+{
+    size_t size = max(this->block_size, minimum_size);
+    this->blocks.push_back({unique_ptr<char[]>(new char[size]), size});
+    this->next = this->blocks.back().data.get();
+    this->remaining = size;
+}
+
+
+string_view StringArena::store(string_view text)
+{
+    if(text.empty()){
+        return string_view();
+    }
+
+    if(text.size() > this->remaining){
+        this->add_block(text.size());
+    }
+    char* copy = this->next;
+    memcpy(copy, text.data(), text.size());
+    this->next += text.size();
+    this->remaining -= text.size();
+    this->stored_bytes += text.size();
+    return string_view(copy, text.size());
+}
+
+
+void StringArena::clear()
+{
+    if(this->blocks.empty()){
+        return;
+    }
+
+    this->blocks.resize(1);
+    this->next = this->blocks[0].data.get();
+    this->remaining = this->blocks[0].size;
+    this->stored_bytes = 0;
+}
+
+
+size_t StringArena::size() const
+{
+    return this->stored_bytes;
+}
+
+
+size_t StringArena::block_count() const
+{
+    return this->blocks.size();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+
+using namespace std;
+
+
+/**
+ * @class StringArena
+ * @brief Monotonic storage for many small strings: the strings are copied one after the other into large blocks of memory.
+ *
+ * Storing a string costs a copy into the current block and no allocation, except when a new block is needed. The strings are never freed one by one:
+ * the whole arena is released at once, by clear or by its destruction, with one deallocation per block.
+ * The views returned by store stay valid until then, even if the arena is moved, since the blocks themselves never move.
+ */
+class StringArena
+{
+    private:
+        struct Block
+        {
+            unique_ptr<char[]> data;
+            size_t size;
+        };
+
+        vector<Block> blocks;
+        size_t block_size;
+
+        // free space at the end of the last block
+        char* next = nullptr;
+        size_t remaining = 0;
+
+        size_t stored_bytes = 0;
+
+        /** Starts a new block with room for at least a given number of bytes */
+        void add_block(size_t minimum_size);
+
+    public:
+
+        static const size_t default_block_size = 64 * 1024;
+
+        /** Public constructor for the StringArena class
+         * @param _block_size: size of the blocks. Strings larger than a block get a block of their own
+         */
+        StringArena(size_t _block_size = default_block_size);
+
+        /** The blocks are handed over to the new arena, the moved-from arena is left empty */
+        StringArena(StringArena&& other) noexcept;
+        StringArena& operator=(StringArena&& other) noexcept;
+
+        /** Copies a string into the arena
+         * @param text: the string to copy
+         * @returns a view over the copy, valid until the arena is cleared or destroyed
+         */
+        string_view store(string_view text);
+
+        /** Releases all the strings at once. The first block is kept, so that an arena reused for a batch of strings after another does not allocate again */
+        void clear();
+
+        /** Total size of the strings stored since the arena was created or cleared */
+        size_t size() const;
+
+        /** Number of blocks allocated */
+        size_t block_count() const;
+};
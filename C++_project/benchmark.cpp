@@ -0,0 +1,668 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <chrono>
+#include <filesystem>
+#include <cmath>
+#include <ctime>
+#include <sys/resource.h>
+#include "CRM.hpp"
+#include "JsonWriter.hpp"
+#include "Snapshot.hpp"
+
+
+using namespace std;
+
+
+/////////////////////////////////////////////////////////////////////
+// Benchmark of the core operations of the CRM on synthetic data, for catching performance regressions between commits.
+// Usage: crm_benchmark [--sizes 1000,10000,100000] [--contracts 4] [--queries 1000] [--seed 42] [--output benchmark_report.json]
+//                      [--work-dir <directory>] [--label <text>] [--baseline <previous report>] [--tolerance 0.1]
+//
+// For each number of customers a CRM is filled by a seeded generator (the same seed always gives the same data), then every operation is timed:
+// add_customer, add_contract, search_customer_matches, search_contracts over all the customers, money and datetime range searches within a customer,
+// save and load (json and snapshot), sort_alphabetically, delete_contract and delete_customer. The report gives, per operation, the count, the throughput, the latency percentiles
+// and the peak RSS of the process once the operation is done. Sizes are run in increasing order, so the peak RSS of a run is the one of its own data.
+// With --baseline, the throughputs are compared with those of a previous report and the exit status is 1 if any dropped by more than the tolerance.
+
+
+/** Parameters of a benchmark run, read from the command line */
+struct BenchmarkOptions
+{
+    vector<size_t> sizes = {1000, 10000, 100000};
+    double contracts_per_customer = 4;      // mean of the number of contracts of a customer
+    size_t queries = 1000;                  // number of timed searches of each kind, the searches over all the customers are a tenth of them
+    uint64_t seed = 42;
+    string output_path = "benchmark_report.json";
+    string work_directory = "";             // where the data files and the log are written, a temporary directory by default
+    string label = "";                      // free text stored in the report, e.g. the commit being measured
+    string baseline_path = "";
+    double tolerance = 0.1;                 // relative drop of throughput reported as a regression
+};
+
+
+/** Returns the peak resident set size of the process in kilobytes */
+static long peak_rss_kb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;      // bytes on macOS
+#else
+    return usage.ru_maxrss;             // kilobytes on Linux
+#endif
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// DATA GENERATOR
+
+
+/**
+ * @class ZipfSampler
+ * @brief Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent: a few values are very common, most are rare, as with names.
+ */
+class ZipfSampler
+{
+    private:
+        vector<double> cumulative_weights;
+
+    public:
+        ZipfSampler(size_t n, double exponent)
+        {
+            this->cumulative_weights.reserve(n);
+            double total = 0;
+            for(size_t rank = 0; rank < n; rank++){
+                total += 1.0 / pow(double(rank + 1), exponent);
+                this->cumulative_weights.push_back(total);
+            }
+        }
+
+        size_t operator()(mt19937_64& generator)
+        {
+            uniform_real_distribution<double> draw(0, this->cumulative_weights.back());
+            size_t rank = upper_bound(this->cumulative_weights.begin(), this->cumulative_weights.end(), draw(generator)) - this->cumulative_weights.begin();
+            return min(rank, this->cumulative_weights.size() - 1);
+        }
+};
+
+
+/**
+ * @class DataGenerator
+ * @brief Seeded generator of synthetic customers and contracts.
+ *
+ * Names and surnames are made of syllables and drawn with a Zipf distribution, so that common names are shared by many customers.
+ * The number of contracts of a customer follows a geometric distribution (most customers have a few contracts, some have many), contract
+ * names come from a catalog of products with a Zipf popularity, amounts follow a log-normal distribution and dates are uniform over 2000-2025.
+ */
+class DataGenerator
+{
+    private:
+        mt19937_64 generator;
+        vector<string> names;
+        vector<string> surnames;
+        vector<string> products;
+        ZipfSampler name_sampler;
+        ZipfSampler surname_sampler;
+        ZipfSampler product_sampler;
+        geometric_distribution<size_t> contract_count;
+        lognormal_distribution<double> money;
+        uniform_int_distribution<int32_t> datetime;
+
+        /** Builds a pool of distinct capitalized words made of 2 to max_syllables syllables */
+        static vector<string> make_words(mt19937_64& generator, size_t count, int max_syllables)
+        {
+            static const vector<string> syllables = {"ba", "be", "bi", "bo", "ca", "co", "da", "de", "di", "do", "fa", "fe", "ga", "gi", "la", "le", "li", "lo", "lu",
+                                                     "ma", "me", "mi", "mo", "na", "ne", "ni", "no", "pa", "pe", "pi", "ra", "re", "ri", "ro", "sa", "se", "si", "so",
+                                                     "ta", "te", "ti", "to", "va", "ve", "vi", "za", "zo", "an", "el", "in", "or", "us", "ar", "en"};
+            uniform_int_distribution<size_t> syllable(0, syllables.size() - 1);
+            uniform_int_distribution<int> length(2, max_syllables);
+
+            unordered_set<string> seen;
+            vector<string> words;
+            words.reserve(count);
+            while(words.size() < count){
+                string word;
+                for(int i = length(generator); i > 0; i--){
+                    word += syllables[syllable(generator)];
+                }
+                word[0] = char(toupper(word[0]));
+                if(seen.insert(word).second){
+                    words.push_back(word);
+                }
+            }
+            return words;
+        }
+
+        static vector<string> make_products()
+        {
+            vector<string> products;
+            for(const string kind: {"Home", "Car", "Life", "Health", "Travel", "Pet", "Business", "Liability", "Boat", "Income", "Dental", "Pension"}){
+                for(const string plan: {"Basic", "Standard", "Premium", "Family", "Gold"}){
+                    products.push_back(kind + " insurance " + plan);
+                }
+            }
+            return products;
+        }
+
+    public:
+        /** Public constructor for the DataGenerator class
+         * @param seed: seed of the pseudo-random generator
+         * @param customers: number of customers to be generated, the pools of names grow with it so that most (name, surname) pairs are distinct
+         * @param contracts_per_customer: mean number of contracts of a customer
+         */
+        DataGenerator(uint64_t seed, size_t customers, double contracts_per_customer)
+            : generator(seed),
+              names(make_words(this->generator, 4000, 3)),
+              surnames(make_words(this->generator, max<size_t>(20000, customers / 4), 4)),
+              products(make_products()),
+              name_sampler(this->names.size(), 0.8),
+              surname_sampler(this->surnames.size(), 0.6),
+              product_sampler(this->products.size(), 1.0),
+              contract_count(1.0 / (contracts_per_customer + 1.0)),
+              money(log(800.0), 1.0),
+              datetime(0, 0)
+        {
+            int32_t first_day, last_day;
+            parse_datetime_string("2000:01:01", first_day);
+            parse_datetime_string("2025:12:31", last_day);
+            this->datetime = uniform_int_distribution<int32_t>(first_day, last_day);
+        }
+
+        void next_customer(string& name, string& surname)
+        {
+            name = this->names[this->name_sampler(this->generator)];
+            surname = this->surnames[this->surname_sampler(this->generator)];
+        }
+
+        /** Generates the contracts of a customer, with names distinct within the customer. The names are stored in the given arena */
+        void next_contracts(vector<StagedContract>& contracts, StringArena& names)
+        {
+            contracts.clear();
+            names.clear();
+            for(size_t i = this->contract_count(this->generator); i > 0; i--){
+                string name = this->products[this->product_sampler(this->generator)];
+                size_t copies = count_if(contracts.begin(), contracts.end(), [&](const StagedContract& contract){ return contract.name.compare(0, name.size(), name) == 0; });
+                if(copies > 0){
+                    name += " " + to_string(copies + 1);
+                }
+                float amount = round(this->money(this->generator) * 100) / 100;
+                contracts.push_back({names.store(name), amount, this->datetime(this->generator)});
+            }
+        }
+
+        mt19937_64& get_generator()
+        {
+            return this->generator;
+        }
+};
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// MEASUREMENTS
+
+
+/**
+ * @class OperationStats
+ * @brief Latencies of the timed calls of an operation, summarized as throughput and percentiles in the report.
+ */
+class OperationStats
+{
+    private:
+        vector<float> latencies_ns;
+        double total_ns = 0;
+        long peak_rss = 0;
+        vector<pair<string, double>> extra_fields;
+
+    public:
+        string name;
+
+        explicit OperationStats(string _name)
+            : name(move(_name))
+        {}
+
+        void add(chrono::steady_clock::duration latency)
+        {
+            double nanoseconds = chrono::duration<double, nano>(latency).count();
+            this->latencies_ns.push_back(float(nanoseconds));
+            this->total_ns += nanoseconds;
+        }
+
+        /** Times a single call of a function */
+        template<typename Function>
+        void time(Function&& function)
+        {
+            auto start = chrono::steady_clock::now();
+            function();
+            this->add(chrono::steady_clock::now() - start);
+        }
+
+        /** Adds a value to the report of the operation, such as the size of a file */
+        void set_extra(const string& key, double value)
+        {
+            this->extra_fields.push_back({key, value});
+        }
+
+        /** Marks the end of the operation, recording the peak RSS reached so far */
+        void finish()
+        {
+            this->peak_rss = peak_rss_kb();
+        }
+
+        double get_throughput() const
+        {
+            return (this->total_ns > 0) ? this->latencies_ns.size() / (this->total_ns * 1e-9) : 0;
+        }
+
+        void write(JsonWriter& writer)
+        {
+            sort(this->latencies_ns.begin(), this->latencies_ns.end());
+            auto percentile = [&](double p){
+                if(this->latencies_ns.empty()){
+                    return 0.0;
+                }
+                size_t index = min(this->latencies_ns.size() - 1, size_t(p * this->latencies_ns.size()));
+                return this->latencies_ns[index] * 1e-3;
+            };
+
+            writer.begin_object();
+            writer.key("count");
+            writer.value(this->latencies_ns.size());
+            for(const pair<string, double>& field: this->extra_fields){
+                writer.key(field.first);
+                writer.value(field.second);
+            }
+            writer.key("latency_us");
+            writer.begin_object();
+            writer.key("max");
+            writer.value(this->latencies_ns.empty() ? 0.0 : this->latencies_ns.back() * 1e-3);
+            writer.key("mean");
+            writer.value(this->latencies_ns.empty() ? 0.0 : this->total_ns * 1e-3 / this->latencies_ns.size());
+            writer.key("p50");
+            writer.value(percentile(0.50));
+            writer.key("p90");
+            writer.value(percentile(0.90));
+            writer.key("p99");
+            writer.value(percentile(0.99));
+            writer.end_object();
+            writer.key("peak_rss_kb");
+            writer.value(this->peak_rss);
+            writer.key("throughput_per_s");
+            writer.value(this->get_throughput());
+            writer.key("total_ms");
+            writer.value(this->total_ns * 1e-6);
+            writer.end_object();
+        }
+};
+
+
+/** Result of the benchmark of one number of customers */
+struct BenchmarkRun
+{
+    size_t customers = 0;
+    size_t contracts = 0;
+    size_t rejected_duplicates = 0;
+    vector<OperationStats> operations;
+};
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// BENCHMARK
+
+
+static BenchmarkRun run_benchmark(size_t size, const BenchmarkOptions& options, const string& work_directory)
+{
+    BenchmarkRun run;
+    string log_path = (filesystem::path(work_directory) / "benchmark.log").string();
+    string load_log_path = (filesystem::path(work_directory) / "benchmark_load.log").string();
+    string json_path = (filesystem::path(work_directory) / "data.json").string();
+    string snapshot_path = (filesystem::path(work_directory) / (string("data") + snapshot_extension)).string();
+
+    DataGenerator data(options.seed + size, size, options.contracts_per_customer);
+    mt19937_64& generator = data.get_generator();
+    CRM crm(log_path);
+
+    // filling the CRM: each contract goes through the same path as one entered by the user, datetime string included
+    OperationStats add_customer("add_customer");
+    OperationStats add_contract("add_contract");
+    string name, surname;
+    vector<StagedContract> contracts;
+    StringArena contract_names;
+    while(crm.get_customer_record().size() < size){
+        data.next_customer(name, surname);
+        bool added;
+        add_customer.time([&]{ added = crm.add_customer(name, surname); });
+        if(!added){
+            run.rejected_duplicates++;
+            continue;
+        }
+
+        Customer* customer = crm.get_customer(crm.find_customer(name, surname));
+        data.next_contracts(contracts, contract_names);
+        for(StagedContract& contract: contracts){
+            string datetime_string = format_datetime_days(contract.datetime);
+            add_contract.time([&]{ crm.add_contract(customer, string(contract.name), contract.money, datetime_string); });
+        }
+        run.contracts += contracts.size();
+    }
+    add_customer.finish();
+    add_contract.finish();
+    run.customers = size;
+    run.operations.push_back(move(add_customer));
+    run.operations.push_back(move(add_contract));
+
+    CustomerStore& customer_record = crm.get_customer_record();
+    uniform_int_distribution<size_t> random_customer(0, size - 1);
+
+    // customer searches: half of them by a piece of a name, as typed while looking for someone, half by full name and surname
+    OperationStats search_customers("search_customer_matches");
+    size_t total_matches = 0;
+    for(size_t i = 0; i < options.queries; i++){
+        Customer& target = customer_record.at(random_customer(generator));
+        vector<string> words;
+        if(i % 2 == 0){
+            string target_name = (i % 4 == 0) ? target.get_name() : target.get_surname();
+            size_t length = min<size_t>(target_name.size(), 3 + i % 3);
+            words.push_back(target_name.substr(uniform_int_distribution<size_t>(0, target_name.size() - length)(generator), length));
+        }
+        else{
+            words = {target.get_name(), target.get_surname()};
+        }
+        search_customers.time([&]{ total_matches += crm.search_customer_matches(words).size(); });
+    }
+    search_customers.set_extra("mean_matches", options.queries ? double(total_matches) / options.queries : 0);
+    search_customers.finish();
+    run.operations.push_back(move(search_customers));
+
+    // range searches over the contracts of all the customers, each selecting a few percent of them
+    int32_t first_day, last_day;
+    parse_datetime_string("2000:01:01", first_day);
+    parse_datetime_string("2025:12:31", last_day);
+    OperationStats search_all("search_contracts");
+    total_matches = 0;
+    size_t global_queries = max<size_t>(10, options.queries / 10);
+    for(size_t i = 0; i < global_queries; i++){
+        ContractQuery query;
+        query.lower_money = uniform_real_distribution<float>(0, 2000)(generator);
+        query.upper_money = query.lower_money + 500;
+        query.start_days = uniform_int_distribution<int32_t>(first_day, last_day - 365)(generator);
+        query.end_days = query.start_days + 365;
+        if(i % 2 == 1){
+            query.name_substring = "premium";
+        }
+        search_all.time([&]{ total_matches += crm.search_contracts(query).size(); });
+    }
+    search_all.set_extra("mean_matches", double(total_matches) / global_queries);
+    search_all.finish();
+    run.operations.push_back(move(search_all));
+
+    // range searches within the contracts of a single customer, as in the contract menu
+    OperationStats search_money("search_contracts_by_money");
+    OperationStats search_datetime("search_contracts_by_datetime");
+    for(size_t i = 0; i < options.queries; i++){
+        ContractRecord& contract_record = customer_record.at(random_customer(generator)).get_contract_record();
+        float lower_money = uniform_real_distribution<float>(0, 2000)(generator);
+        int32_t start_days = uniform_int_distribution<int32_t>(first_day, last_day - 3650)(generator);
+        search_money.time([&]{ contract_record.search_contracts_by_money(lower_money, lower_money * 2); });
+        search_datetime.time([&]{ contract_record.search_contracts_by_datetime(start_days, start_days + 3650); });
+    }
+    search_money.finish();
+    search_datetime.finish();
+    run.operations.push_back(move(search_money));
+    run.operations.push_back(move(search_datetime));
+
+    // saving and loading, each load into an empty CRM. The table of contract names is shared by the whole process and already holds the names,
+    // so the snapshot is loaded by copying its contracts rather than by mapping them in place
+    OperationStats save_json("save");
+    save_json.time([&]{ crm.save(json_path); });
+    save_json.set_extra("bytes", filesystem::file_size(json_path));
+    save_json.finish();
+    run.operations.push_back(move(save_json));
+
+    OperationStats save_snapshot("save_snapshot");
+    save_snapshot.time([&]{ crm.save_snapshot(snapshot_path); });
+    save_snapshot.set_extra("bytes", filesystem::file_size(snapshot_path));
+    save_snapshot.finish();
+    run.operations.push_back(move(save_snapshot));
+
+    OperationStats load_json("load");
+    {
+        CRM loaded(load_log_path);
+        load_json.time([&]{ loaded.load_data(json_path); });
+        load_json.finish();
+    }
+    run.operations.push_back(move(load_json));
+
+    OperationStats load_snapshot("load_snapshot");
+    {
+        CRM loaded(load_log_path);
+        load_snapshot.time([&]{ loaded.load_snapshot(snapshot_path); });
+        load_snapshot.finish();
+    }
+    run.operations.push_back(move(load_snapshot));
+
+    // the customers are in the random order of their generation
+    OperationStats sort_customers("sort_alphabetically");
+    sort_customers.time([&]{ crm.sort_alphabetically(); });
+    sort_customers.finish();
+    run.operations.push_back(move(sort_customers));
+
+    // deleting the oldest contract of random customers
+    OperationStats delete_contract("delete_contract");
+    for(size_t i = 0; i < options.queries; i++){
+        Customer* customer = &(customer_record.at(random_customer(generator)));
+        vector<Contract> contracts = customer->get_contract_record().search_contracts_by_datetime(numeric_limits<int32_t>::min(), numeric_limits<int32_t>::max());
+        if(!(contracts.empty())){
+            delete_contract.time([&]{ crm.delete_contract(customer, contracts.front()); });
+        }
+    }
+    delete_contract.finish();
+    run.operations.push_back(move(delete_contract));
+
+    // deleting a tenth of the customers, picked at random
+    vector<CustomerHandle> deleted_customers;
+    for(auto iterator = customer_record.begin(); iterator != customer_record.end(); ++iterator){
+        deleted_customers.push_back(iterator.handle());
+    }
+    shuffle(deleted_customers.begin(), deleted_customers.end(), generator);
+    deleted_customers.resize(max<size_t>(1, size / 10));
+    OperationStats delete_customer("delete_customer");
+    for(CustomerHandle handle: deleted_customers){
+        delete_customer.time([&]{ crm.delete_customer(handle); });
+    }
+    delete_customer.finish();
+    run.operations.push_back(move(delete_customer));
+
+    filesystem::remove(json_path);
+    filesystem::remove(snapshot_path);
+    return run;
+}
+
+
+static void write_report(const string& file_path, const BenchmarkOptions& options, vector<BenchmarkRun>& runs)
+{
+    ofstream output_file(file_path);
+    if(!output_file){
+        throw runtime_error("\nCould not write the report to file: " + file_path + "\n");
+    }
+
+    time_t now = time(nullptr);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    JsonWriter writer(output_file);
+    writer.begin_object();
+    writer.key("configuration");
+    writer.begin_object();
+    writer.key("contracts_per_customer");
+    writer.value(options.contracts_per_customer);
+    writer.key("queries");
+    writer.value(options.queries);
+    writer.key("seed");
+    writer.value(options.seed);
+    writer.end_object();
+    writer.key("environment");
+    writer.begin_object();
+    writer.key("compiler");
+    writer.value(string(__VERSION__));
+    writer.key("label");
+    writer.value(options.label);
+    writer.key("timestamp");
+    writer.value(string(timestamp));
+    writer.end_object();
+    writer.key("runs");
+    writer.begin_array();
+    for(BenchmarkRun& run: runs){
+        writer.begin_object();
+        writer.key("contracts");
+        writer.value(run.contracts);
+        writer.key("customers");
+        writer.value(run.customers);
+        writer.key("operations");
+        writer.begin_object();
+        for(OperationStats& operation: run.operations){
+            writer.key(operation.name);
+            operation.write(writer);
+        }
+        writer.end_object();
+        writer.key("rejected_duplicates");
+        writer.value(run.rejected_duplicates);
+        writer.end_object();
+    }
+    writer.end_array();
+    writer.end_object();
+    output_file << endl;
+}
+
+
+/** Compares the throughputs with those of a previous report, for the numbers of customers found in both
+ * @returns the number of operations whose throughput dropped by more than the tolerance
+ */
+static size_t compare_with_baseline(const string& baseline_path, double tolerance, vector<BenchmarkRun>& runs)
+{
+    ifstream baseline_file(baseline_path);
+    if(!baseline_file){
+        throw runtime_error("\nCould not open the baseline report: " + baseline_path + "\n");
+    }
+    json baseline = json::parse(baseline_file);
+
+    size_t regressions = 0;
+    cout << endl << "Comparison with " << baseline_path << " (throughput, new / baseline):" << endl;
+    for(BenchmarkRun& run: runs){
+        for(const json& baseline_run: baseline.at("runs")){
+            if(baseline_run.at("customers").get<size_t>() != run.customers){
+                continue;
+            }
+            for(OperationStats& operation: run.operations){
+                if(!(baseline_run.at("operations").contains(operation.name))){
+                    continue;
+                }
+                double baseline_throughput = baseline_run.at("operations").at(operation.name).at("throughput_per_s").get<double>();
+                double ratio = (baseline_throughput > 0) ? operation.get_throughput() / baseline_throughput : 1;
+                bool regression = ratio < 1 - tolerance;
+                regressions += regression;
+                printf("  %9zu customers  %-30s %6.2fx%s\n", run.customers, operation.name.c_str(), ratio, regression ? "  REGRESSION" : "");
+            }
+        }
+    }
+    return regressions;
+}
+
+
+/** Parses a comma separated list of sizes, such as 1000,10000,100000 */
+static vector<size_t> parse_sizes(const string& text)
+{
+    vector<size_t> sizes;
+    stringstream stream(text);
+    string item;
+    while(getline(stream, item, ',')){
+        size_t size = stoull(item);
+        if(size == 0){
+            throw runtime_error("\nThe numbers of customers must be positive\n");
+        }
+        sizes.push_back(size);
+    }
+    sort(sizes.begin(), sizes.end());
+    return sizes;
+}
+
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    try{
+        for(int i = 1; i < argc; i++){
+            string argument = argv[i];
+            bool has_value = (i + 1 < argc);
+            if((argument == "--sizes") && has_value){
+                options.sizes = parse_sizes(argv[++i]);
+            }
+            else if((argument == "--contracts") && has_value){
+                options.contracts_per_customer = stod(argv[++i]);
+            }
+            else if((argument == "--queries") && has_value){
+                options.queries = stoull(argv[++i]);
+            }
+            else if((argument == "--seed") && has_value){
+                options.seed = stoull(argv[++i]);
+            }
+            else if((argument == "--output") && has_value){
+                options.output_path = argv[++i];
+            }
+            else if((argument == "--work-dir") && has_value){
+                options.work_directory = argv[++i];
+            }
+            else if((argument == "--label") && has_value){
+                options.label = argv[++i];
+            }
+            else if((argument == "--baseline") && has_value){
+                options.baseline_path = argv[++i];
+            }
+            else if((argument == "--tolerance") && has_value){
+                options.tolerance = stod(argv[++i]);
+            }
+            else{
+                cerr << "Usage: crm_benchmark [--sizes 1000,10000,100000] [--contracts 4] [--queries 1000] [--seed 42] [--output benchmark_report.json]" << endl
+                     << "                     [--work-dir <directory>] [--label <text>] [--baseline <previous report>] [--tolerance 0.1]" << endl;
+                return 2;
+            }
+        }
+    }
+    catch(const exception& error){
+        cerr << "Invalid argument: " << error.what() << endl;
+        return 2;
+    }
+
+    string work_directory = options.work_directory.empty() ? (filesystem::temp_directory_path() / "crm_benchmark").string() : options.work_directory;
+    filesystem::create_directories(work_directory);
+
+    vector<BenchmarkRun> runs;
+    for(size_t size: options.sizes){
+        cout << "Benchmarking " << size << " customers..." << endl;
+        runs.push_back(run_benchmark(size, options, work_directory));
+        for(OperationStats& operation: runs.back().operations){
+            printf("  %-30s %14.1f ops/s\n", operation.name.c_str(), operation.get_throughput());
+        }
+    }
+
+    write_report(options.output_path, options, runs);
+    cout << "Report written to " << options.output_path << endl;
+
+    if(!(options.baseline_path.empty())){
+        size_t regressions = compare_with_baseline(options.baseline_path, options.tolerance, runs);
+        if(regressions > 0){
+            cout << regressions << " operations slower than the baseline by more than " << options.tolerance * 100 << "%" << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include "CRM.hpp"
+
+
+using namespace std;
+
+
+/////////////////////////////////////////////////////////////////////
+// Test of loading a directory of json files when one of them is malformed. The files are parsed in parallel, so an error must neither leave
+// the loading waiting for files that will never be parsed nor lose the files before the malformed one.
+// Usage: load_files_test [--work-dir <directory>]. The exit status is 1 if any check fails.
+
+
+// how long a load may take before it is considered stuck
+static const chrono::seconds load_timeout(60);
+
+
+/** Writes a valid data file with a given number of customers, each with a few contracts, named after the file so that no two files conflict */
+static void write_data_file(const filesystem::path& path, const string& prefix, size_t customers)
+{
+    ofstream file(path);
+    file << "{\"customer_record\": [";
+    for(size_t i = 0; i < customers; i++){
+        file << (i == 0 ? "" : ",") << "{\"name\": \"" << prefix << "\", \"surname\": \"S" << i << "\", \"contract_record\": {\"contract_record\": [";
+        for(size_t j = 0; j < 5; j++){
+            file << (j == 0 ? "" : ",") << "{\"name\": \"Contract " << j << "\", \"money\": " << 100 * (j + 1) << ", \"datetime\": \"2020:01:0" << j + 1 << "\"}";
+        }
+        file << "]}}";
+    }
+    file << "]}";
+}
+
+
+/** Loads a directory into a new CRM, giving up if the loading does not end in time
+ * @param directory: the directory to load
+ * @param log_path: the log file of the CRM
+ * @param customers: set to the number of customers loaded
+ * @param error: set to whether the loading reported an error
+ * @returns false if the loading got stuck
+ */
+static bool load_directory(const filesystem::path& directory, const string& log_path, size_t& customers, bool& error)
+{
+    // the loading runs on a detached thread, which a stuck loading never lets go of: unlike a future from async, which waits for its
+    // thread when destroyed, the future of a promise can be given up on. The CRM is shared with the thread for the same reason
+    shared_ptr<CRM> crm = make_shared<CRM>(log_path);
+    shared_ptr<promise<bool>> result = make_shared<promise<bool>>();
+    future<bool> loading = result->get_future();
+    thread([crm, result, directory](){
+        try{
+            crm->load_data(directory.string());
+            result->set_value(false);
+        }
+        catch(const exception&){
+            result->set_value(true);
+        }
+    }).detach();
+
+    if(loading.wait_for(load_timeout) == future_status::timeout){
+        return false;
+    }
+    error = loading.get();
+    customers = crm->get_customer_record().size();
+    return true;
+}
+
+
+/** Runs one case and prints its outcome
+ * @returns whether the loading ended with an error and the expected number of customers
+ */
+static bool check_case(const string& name, const filesystem::path& directory, const string& log_path, size_t expected_customers)
+{
+    size_t customers = 0;
+    bool error = false;
+    if(!(load_directory(directory, log_path, customers, error))){
+        cout << "FAIL  " << name << ": the loading did not end within " << load_timeout.count() << " s" << endl;
+        return false;
+    }
+
+    bool passed = error && (customers == expected_customers);
+    cout << (passed ? "ok    " : "FAIL  ") << name << ": " << (error ? "error reported" : "no error reported") << ", " << customers << " customers loaded (expected "
+         << expected_customers << ")" << endl;
+    return passed;
+}
+
+
+int main(int argc, char* argv[])
+{
+    filesystem::path work_directory = filesystem::temp_directory_path() / "crm_load_files_test";
+    for(int i = 1; i < argc; i++){
+        if((string(argv[i]) == "--work-dir") && (i + 1 < argc)){
+            work_directory = argv[++i];
+        }
+    }
+    filesystem::remove_all(work_directory);
+    filesystem::create_directories(work_directory);
+    string log_path = (work_directory / "logfile_test").string();
+
+    // files are loaded in order of name: enough valid files, large enough, that the parsing threads are still busy when the malformed one is met
+    const size_t valid_files = 16;
+    const size_t customers_per_file = 2000;
+    filesystem::path bad_first = work_directory / "bad_first";
+    filesystem::path bad_middle = work_directory / "bad_middle";
+    filesystem::create_directories(bad_first);
+    filesystem::create_directories(bad_middle);
+    for(size_t i = 0; i < valid_files; i++){
+        string file_name = "data_" + string(i < 10 ? "0" : "") + to_string(i) + ".json";
+        write_data_file(bad_first / file_name, "F" + to_string(i), customers_per_file);
+        write_data_file(bad_middle / file_name, "M" + to_string(i), customers_per_file);
+    }
+    ofstream(bad_first / "a_malformed.json") << "{\"customer_record\": [ {";
+    ofstream(bad_middle / "data_03_malformed.json") << "{\"customer_record\": [ {";
+
+    bool passed = true;
+    // nothing is loaded when the first file is malformed
+    passed &= check_case("malformed first file", bad_first, log_path, 0);
+    // the files before the malformed one stay loaded: data_00 to data_03
+    passed &= check_case("malformed file among valid ones", bad_middle, log_path, 4 * customers_per_file);
+
+    filesystem::remove_all(work_directory);
+    // a stuck loading thread is still running, and would be waited for by a normal exit
+    cout.flush();
+    _Exit(passed ? 0 : 1);
+}
@@ -0,0 +1,200 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+#include "Logger.hpp"
+
+
+using namespace std;
+
+
+/////////////////////////////////////////////////////////////////////
+// Offline tool turning a binary log written by the Logger (LogFormat::binary) back into text.
+// Usage: log_decoder <binary log file> [--timestamps]
+// Text written through the logfile stream is printed as it is, events are printed as "[LEVEL] message", optionally preceded by their timestamp and call site.
+
+
+/** Reads a value from the binary log
+ * @param in: the log file
+ * @param value: variable to store the value
+ * @returns false if the file ended before the whole value was read
+*/
+template<typename T>
+static bool read_value(istream& in, T& value)
+{
+    return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+/** Reads a string preceded by its length from the binary log */
+template<typename Length>
+static bool read_string(istream& in, string& value)
+{
+    Length length;
+    if(!(read_value(in, length))){
+        return false;
+    }
+    value.resize(length);
+    return bool(in.read(value.data(), length));
+}
+
+/** Formats a timestamp of the binary log as YYYY-MM-DD HH:MM:SS.ffffff (UTC) */
+static string format_timestamp(int64_t nanoseconds)
+{
+    time_t seconds = nanoseconds / 1000000000;
+    tm datetime_struct = {};
+    gmtime_r(&seconds, &datetime_struct);
+
+    char text[64];
+    snprintf(text, sizeof(text), "%04d-%02d-%02d %02d:%02d:%02d.%06lld ", datetime_struct.tm_year + 1900, datetime_struct.tm_mon + 1, datetime_struct.tm_mday,
+             datetime_struct.tm_hour, datetime_struct.tm_min, datetime_struct.tm_sec, (long long)((nanoseconds % 1000000000) / 1000));
+    return text;
+}
+
+/** Reads the arguments of an event and converts them to text
+ * @param in: the log file, positioned on the first argument
+ * @param argument_count: number of arguments of the event
+ * @param arguments: vector to store the arguments
+ * @returns false if the arguments are truncated or malformed
+*/
+static bool read_arguments(istream& in, uint8_t argument_count, vector<string>& arguments)
+{
+    arguments.clear();
+    for(uint8_t i = 0; i < argument_count; i++){
+        uint8_t type;
+        if(!(read_value(in, type))){
+            return false;
+        }
+
+        switch(LogArgumentType(type)){
+            case LogArgumentType::signed_integer: {
+                int64_t value;
+                if(!(read_value(in, value))){ return false; }
+                arguments.push_back(log_argument_text(value));
+                break;
+            }
+            case LogArgumentType::unsigned_integer: {
+                uint64_t value;
+                if(!(read_value(in, value))){ return false; }
+                arguments.push_back(log_argument_text(value));
+                break;
+            }
+            case LogArgumentType::floating_point: {
+                double value;
+                if(!(read_value(in, value))){ return false; }
+                arguments.push_back(log_argument_text(value));
+                break;
+            }
+            case LogArgumentType::boolean: {
+                uint8_t value;
+                if(!(read_value(in, value))){ return false; }
+                arguments.push_back(log_argument_text(bool(value)));
+                break;
+            }
+            case LogArgumentType::string: {
+                string value;
+                if(!(read_string<uint32_t>(in, value))){ return false; }
+                arguments.push_back(value);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2){
+        cerr << "Usage: " << argv[0] << " <binary log file> [--timestamps]" << endl;
+        return 1;
+    }
+    bool print_timestamps = (argc > 2) && (string(argv[2]) == "--timestamps");
+
+    ifstream in(argv[1], ios::binary);
+    if(!in){
+        cerr << "Failed to open log file: " << argv[1] << endl;
+        return 1;
+    }
+
+    char magic[sizeof(log_binary_magic)];
+    if(!(in.read(magic, sizeof(magic))) || !(equal(magic, magic + sizeof(magic), log_binary_magic))){
+        cerr << argv[1] << " is not a binary log file" << endl;
+        return 1;
+    }
+
+    unordered_map<uint32_t, LogEventDefinition> events;
+    vector<string> arguments;
+    bool at_line_start = true;
+    uint8_t record_type;
+
+    while(read_value(in, record_type)){
+        bool complete = true;
+
+        switch(LogRecordType(record_type)){
+            case LogRecordType::event_definition: {
+                uint32_t event_id;
+                uint8_t level;
+                LogEventDefinition event;
+                complete = read_value(in, event_id) && read_value(in, level) && read_value(in, event.line)
+                            && read_string<uint16_t>(in, event.file) && read_string<uint16_t>(in, event.format_string);
+                event.level = LogLevel(level);
+                events[event_id] = event;
+                break;
+            }
+            case LogRecordType::event: {
+                int64_t timestamp;
+                uint32_t event_id;
+                uint8_t argument_count;
+                complete = read_value(in, timestamp) && read_value(in, event_id) && read_value(in, argument_count) && read_arguments(in, argument_count, arguments);
+                if(!complete){
+                    break;
+                }
+
+                auto event = events.find(event_id);
+                if(event == events.end()){
+                    cerr << "Event " << event_id << " used before its definition" << endl;
+                    return 1;
+                }
+
+                // events always start on a new line, as in the text format
+                if(!at_line_start){
+                    cout << '\n';
+                }
+                if(print_timestamps){
+                    cout << format_timestamp(timestamp) << event->second.file << ":" << event->second.line << " ";
+                }
+                cout << "[" << log_level_name(event->second.level) << "] " << format_log_message(event->second.format_string, arguments) << '\n';
+                at_line_start = true;
+                break;
+            }
+            case LogRecordType::text: {
+                int64_t timestamp;
+                string text;
+                complete = read_value(in, timestamp) && read_string<uint32_t>(in, text);
+                if(complete && !(text.empty())){
+                    cout << text;
+                    at_line_start = (text.back() == '\n');
+                }
+                break;
+            }
+            default:
+                cerr << "Unknown record type " << int(record_type) << endl;
+                return 1;
+        }
+
+        // the last record may be truncated if the application was killed while writing it
+        if(!complete){
+            cerr << "The log ends with a truncated record" << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
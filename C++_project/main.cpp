@@ -1,18 +1,75 @@
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <ctime>
 
 #include "CRM.hpp"
+#include "Batch.hpp"
 
 
 using namespace std;
 
 
-int main()
+int main(int argc, char* argv[])
 {
 
+    // the program only uses the C++ streams, which no longer need to stay in step with the C ones. Reading a scripted input gets much faster,
+    // and prompts are still shown before each input since cin stays tied to cout
+    ios::sync_with_stdio(false);
+
     string logfile_path = "./logfile_CRM";
-    CRM crm(logfile_path);
+    LoggerOptions logger_options;
+
+    string store_directory = "";
+    string batch_path = "";
+    string output_path = "";
+
+    // the log can be written in the compact binary format, to be read with the log_decoder tool.
+    // With a data store, the data is loaded at startup and every edit is persisted as it is made.
+    // With a batch file ("-" for the standard input), its commands are executed instead of showing the menu, and their results are written to
+    // the output file or to the standard output
+    for(int i = 1; i < argc; i++){
+        if(string(argv[i]) == "--binary-log"){
+            logger_options.format = LogFormat::binary;
+        }
+        else if((string(argv[i]) == "--store") && (i + 1 < argc)){
+            store_directory = argv[++i];
+        }
+        else if((string(argv[i]) == "--batch") && (i + 1 < argc)){
+            batch_path = argv[++i];
+        }
+        else if((string(argv[i]) == "--output") && (i + 1 < argc)){
+            output_path = argv[++i];
+        }
+    }
+
+    CRM crm(logfile_path, logger_options, store_directory);
+
+    if(batch_path.empty()){
+        crm.main_menu();
+        return 0;
+    }
+
+    ifstream batch_file;
+    if(batch_path != "-"){
+        batch_file.open(batch_path);
+        if(!batch_file){
+            cerr << "Could not open batch file: " << batch_path << endl;
+            return 2;
+        }
+    }
+    ofstream output_file;
+    if(!(output_path.empty())){
+        output_file.open(output_path);
+        if(!output_file){
+            cerr << "Could not open output file: " << output_path << endl;
+            return 2;
+        }
+    }
+
+    BatchRunner runner(crm, output_path.empty() ? cout : output_file);
+    size_t failed_commands = runner.run((batch_path == "-") ? cin : batch_file);
 
-    return 0;
-}
\ No newline at end of file
+    // the exit status tells scripts whether every command succeeded
+    return (failed_commands == 0) ? 0 : 1;
+}
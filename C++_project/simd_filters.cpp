@@ -0,0 +1,253 @@
+#include <vector>
+#include <cstdint>
+#include "simd_filters.hpp"
+
+// the vectorized kernels are compiled only for x86 processors, with compilers supporting per-function target attributes (gcc and clang)
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_FILTERS_X86
+#include <immintrin.h>
+#endif
+
+
+using namespace std;
+
+
+/////////////////////////////////////////////////////////////////////
+// scalar kernels, used on processors without vector instructions and for the elements left over by the vectorized loops.
+// The conditions are combined with & rather than && so that the loop body has no branch other than the one appending the position
+
+
+static void filter_money_range_scalar(const float* money, size_t begin, size_t size, float lower_money, float upper_money, vector<size_t>& positions)
+{
+    for(size_t i = begin; i < size; i++){
+        if((money[i] >= lower_money) & (money[i] <= upper_money)){
+            positions.push_back(i);
+        }
+    }
+}
+
+static void filter_datetime_range_scalar(const int32_t* datetimes, size_t begin, size_t size, int32_t start_days, int32_t end_days, vector<size_t>& positions)
+{
+    for(size_t i = begin; i < size; i++){
+        if((datetimes[i] >= start_days) & (datetimes[i] <= end_days)){
+            positions.push_back(i);
+        }
+    }
+}
+
+static void filter_money_and_datetime_range_scalar(const float* money, const int32_t* datetimes, size_t begin, size_t size, float lower_money, float upper_money, int32_t start_days, int32_t end_days, vector<size_t>& positions)
+{
+    for(size_t i = begin; i < size; i++){
+        if((money[i] >= lower_money) & (money[i] <= upper_money) & (datetimes[i] >= start_days) & (datetimes[i] <= end_days)){
+            positions.push_back(i);
+        }
+    }
+}
+
+
+
+#ifdef SIMD_FILTERS_X86
+
+/** Appends the positions corresponding to the bits set in a comparison mask
+ * @param mask: one bit per element of the vector, set if the element matched
+ * @param base: position of the first element of the vector
+ * @param positions: vector the positions are appended to
+*/
+static inline void append_mask_positions(unsigned mask, size_t base, vector<size_t>& positions)
+{
+    while(mask != 0){
+        positions.push_back(base + __builtin_ctz(mask));
+        mask &= mask - 1;   // clear the lowest bit set
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////
+// SSE2 kernels, 4 elements per iteration.
+// SSE2 has no "greater or equal" comparison for integers, so x >= start is computed as !(start > x) and x <= end as !(x > end)
+
+__attribute__((target("sse2")))
+static void filter_money_range_sse2(const float* money, size_t size, float lower_money, float upper_money, vector<size_t>& positions)
+{
+    __m128 lower = _mm_set1_ps(lower_money);
+    __m128 upper = _mm_set1_ps(upper_money);
+    size_t i = 0;
+    for(; i + 4 <= size; i += 4){
+        __m128 values = _mm_loadu_ps(money + i);
+        __m128 match = _mm_and_ps(_mm_cmpge_ps(values, lower), _mm_cmple_ps(values, upper));
+        append_mask_positions(_mm_movemask_ps(match), i, positions);
+    }
+    filter_money_range_scalar(money, i, size, lower_money, upper_money, positions);
+}
+
+__attribute__((target("sse2")))
+static void filter_datetime_range_sse2(const int32_t* datetimes, size_t size, int32_t start_days, int32_t end_days, vector<size_t>& positions)
+{
+    __m128i start = _mm_set1_epi32(start_days);
+    __m128i end = _mm_set1_epi32(end_days);
+    size_t i = 0;
+    for(; i + 4 <= size; i += 4){
+        __m128i values = _mm_loadu_si128((const __m128i*)(datetimes + i));
+        __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(start, values), _mm_cmpgt_epi32(values, end));
+        append_mask_positions(~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF, i, positions);
+    }
+    filter_datetime_range_scalar(datetimes, i, size, start_days, end_days, positions);
+}
+
+__attribute__((target("sse2")))
+static void filter_money_and_datetime_range_sse2(const float* money, const int32_t* datetimes, size_t size, float lower_money, float upper_money, int32_t start_days, int32_t end_days, vector<size_t>& positions)
+{
+    __m128 lower = _mm_set1_ps(lower_money);
+    __m128 upper = _mm_set1_ps(upper_money);
+    __m128i start = _mm_set1_epi32(start_days);
+    __m128i end = _mm_set1_epi32(end_days);
+    size_t i = 0;
+    for(; i + 4 <= size; i += 4){
+        __m128 money_values = _mm_loadu_ps(money + i);
+        __m128i datetime_values = _mm_loadu_si128((const __m128i*)(datetimes + i));
+        __m128 money_match = _mm_and_ps(_mm_cmpge_ps(money_values, lower), _mm_cmple_ps(money_values, upper));
+        __m128i datetime_outside = _mm_or_si128(_mm_cmpgt_epi32(start, datetime_values), _mm_cmpgt_epi32(datetime_values, end));
+        __m128 match = _mm_andnot_ps(_mm_castsi128_ps(datetime_outside), money_match);
+        append_mask_positions(_mm_movemask_ps(match), i, positions);
+    }
+    filter_money_and_datetime_range_scalar(money, datetimes, i, size, lower_money, upper_money, start_days, end_days, positions);
+}
+
+
+/////////////////////////////////////////////////////////////////////
+// AVX2 kernels, 8 elements per iteration. The float comparisons are ordered, so that NaN never matches as in the scalar kernels
+
+__attribute__((target("avx2")))
+static void filter_money_range_avx2(const float* money, size_t size, float lower_money, float upper_money, vector<size_t>& positions)
+{
+    __m256 lower = _mm256_set1_ps(lower_money);
+    __m256 upper = _mm256_set1_ps(upper_money);
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        __m256 values = _mm256_loadu_ps(money + i);
+        __m256 match = _mm256_and_ps(_mm256_cmp_ps(values, lower, _CMP_GE_OQ), _mm256_cmp_ps(values, upper, _CMP_LE_OQ));
+        append_mask_positions(_mm256_movemask_ps(match), i, positions);
+    }
+    filter_money_range_scalar(money, i, size, lower_money, upper_money, positions);
+}
+
+__attribute__((target("avx2")))
+static void filter_datetime_range_avx2(const int32_t* datetimes, size_t size, int32_t start_days, int32_t end_days, vector<size_t>& positions)
+{
+    __m256i start = _mm256_set1_epi32(start_days);
+    __m256i end = _mm256_set1_epi32(end_days);
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        __m256i values = _mm256_loadu_si256((const __m256i*)(datetimes + i));
+        __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(start, values), _mm256_cmpgt_epi32(values, end));
+        append_mask_positions(~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF, i, positions);
+    }
+    filter_datetime_range_scalar(datetimes, i, size, start_days, end_days, positions);
+}
+
+__attribute__((target("avx2")))
+static void filter_money_and_datetime_range_avx2(const float* money, const int32_t* datetimes, size_t size, float lower_money, float upper_money, int32_t start_days, int32_t end_days, vector<size_t>& positions)
+{
+    __m256 lower = _mm256_set1_ps(lower_money);
+    __m256 upper = _mm256_set1_ps(upper_money);
+    __m256i start = _mm256_set1_epi32(start_days);
+    __m256i end = _mm256_set1_epi32(end_days);
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        __m256 money_values = _mm256_loadu_ps(money + i);
+        __m256i datetime_values = _mm256_loadu_si256((const __m256i*)(datetimes + i));
+        __m256 money_match = _mm256_and_ps(_mm256_cmp_ps(money_values, lower, _CMP_GE_OQ), _mm256_cmp_ps(money_values, upper, _CMP_LE_OQ));
+        __m256i datetime_outside = _mm256_or_si256(_mm256_cmpgt_epi32(start, datetime_values), _mm256_cmpgt_epi32(datetime_values, end));
+        __m256 match = _mm256_andnot_ps(_mm256_castsi256_ps(datetime_outside), money_match);
+        append_mask_positions(_mm256_movemask_ps(match), i, positions);
+    }
+    filter_money_and_datetime_range_scalar(money, datetimes, i, size, lower_money, upper_money, start_days, end_days, positions);
+}
+
+#endif
+
+
+
+/////////////////////////////////////////////////////////////////////
+// runtime dispatch
+
+enum class InstructionSet { scalar, sse2, avx2 };
+
+/** Detects the best instruction set supported by the processor, only once */
+static InstructionSet get_instruction_set()
+{
+    static const InstructionSet instruction_set = [](){
+#ifdef SIMD_FILTERS_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")){
+            return InstructionSet::avx2;
+        }
+        if(__builtin_cpu_supports("sse2")){
+            return InstructionSet::sse2;
+        }
+#endif
+        return InstructionSet::scalar;
+    }();
+    return instruction_set;
+}
+
+
+void filter_money_range(const float* money, size_t size, float lower_money, float upper_money, vector<size_t>& positions)
+{
+    switch(get_instruction_set()){
+#ifdef SIMD_FILTERS_X86
+        case InstructionSet::avx2:
+            filter_money_range_avx2(money, size, lower_money, upper_money, positions);
+            return;
+        case InstructionSet::sse2:
+            filter_money_range_sse2(money, size, lower_money, upper_money, positions);
+            return;
+#endif
+        default:
+            filter_money_range_scalar(money, 0, size, lower_money, upper_money, positions);
+    }
+}
+
+void filter_datetime_range(const int32_t* datetimes, size_t size, int32_t start_days, int32_t end_days, vector<size_t>& positions)
+{
+    switch(get_instruction_set()){
+#ifdef SIMD_FILTERS_X86
+        case InstructionSet::avx2:
+            filter_datetime_range_avx2(datetimes, size, start_days, end_days, positions);
+            return;
+        case InstructionSet::sse2:
+            filter_datetime_range_sse2(datetimes, size, start_days, end_days, positions);
+            return;
+#endif
+        default:
+            filter_datetime_range_scalar(datetimes, 0, size, start_days, end_days, positions);
+    }
+}
+
+void filter_money_and_datetime_range(const float* money, const int32_t* datetimes, size_t size, float lower_money, float upper_money, int32_t start_days, int32_t end_days, vector<size_t>& positions)
+{
+    switch(get_instruction_set()){
+#ifdef SIMD_FILTERS_X86
+        case InstructionSet::avx2:
+            filter_money_and_datetime_range_avx2(money, datetimes, size, lower_money, upper_money, start_days, end_days, positions);
+            return;
+        case InstructionSet::sse2:
+            filter_money_and_datetime_range_sse2(money, datetimes, size, lower_money, upper_money, start_days, end_days, positions);
+            return;
+#endif
+        default:
+            filter_money_and_datetime_range_scalar(money, datetimes, 0, size, lower_money, upper_money, start_days, end_days, positions);
+    }
+}
+
+const char* simd_filters_instruction_set()
+{
+    switch(get_instruction_set()){
+        case InstructionSet::avx2:
+            return "avx2";
+        case InstructionSet::sse2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+using namespace std;
+
+
+/////////////////////////////////////////////////////////////////////
+// Range filter kernels over the contract columns stored by ContractRecord.
+// Each kernel appends to a vector the positions of the elements satisfying the filter, in increasing order.
+// On x86 processors the kernels use AVX2 or SSE2 instructions, the best available instruction set being detected once at runtime so that the same
+// executable runs on any host. On other processors a portable scalar version is used.
+
+
+/** Finds the amounts of money within a range
+ * @param money: pointer to the first element of the money column
+ * @param size: number of elements in the column
+ * @param lower_money: lower bound of the range (included)
+ * @param upper_money: upper bound of the range (included)
+ * @param positions: vector the positions of the matching elements are appended to
+*/
+void filter_money_range(const float* money, size_t size, float lower_money, float upper_money, vector<size_t>& positions);
+
+/** Finds the datetimes within a range
+ * @param datetimes: pointer to the first element of the datetime column (day numbers)
+ * @param size: number of elements in the column
+ * @param start_days: first day of the range (included)
+ * @param end_days: last day of the range (included)
+ * @param positions: vector the positions of the matching elements are appended to
+*/
+void filter_datetime_range(const int32_t* datetimes, size_t size, int32_t start_days, int32_t end_days, vector<size_t>& positions);
+
+/** Finds the positions at which both the amount of money and the datetime are within their ranges
+ * @param money: pointer to the first element of the money column
+ * @param datetimes: pointer to the first element of the datetime column, with as many elements as the money column
+ * @param size: number of elements in each column
+ * @param lower_money: lower bound of the money range (included)
+ * @param upper_money: upper bound of the money range (included)
+ * @param start_days: first day of the datetime range (included)
+ * @param end_days: last day of the datetime range (included)
+ * @param positions: vector the positions of the matching elements are appended to
+*/
+void filter_money_and_datetime_range(const float* money, const int32_t* datetimes, size_t size, float lower_money, float upper_money, int32_t start_days, int32_t end_days, vector<size_t>& positions);
+
+/** Returns the name of the instruction set used by the kernels on this host ("avx2", "sse2" or "scalar") */
+const char* simd_filters_instruction_set();
@@ -1,13 +1,25 @@
 #pragma once 
 
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdlib>
+#include <cerrno>
 #include <cctype>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <limits>
+#include <iomanip>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iterator>
 #include <filesystem>
 #include "json.hpp"
+#include "Logger.hpp"
 
 
 
@@ -27,26 +39,6 @@ inline const string invalid_money_message = "You must insert a positive value" ;
 inline const vector<string> yes_no_possible_answers = {"y", "n"};
 
 
-/**
- * @class Logger
- * @brief Implements a logger that keeps track of the actions executed by the CRM application
- */
-class Logger{
-
-    public:
-        ofstream logfile;
-
-        Logger(){}
-
-        Logger(string logfile_name){
-            this->logfile.open(logfile_name, std::ios::out);
-            if (!(this->logfile)) {
-                    throw std::runtime_error("Failed to open logging file: " + logfile_name);
-            }
-        }
-};
-
-
 /////////////////////////////////////////////////////////////////////
 /////// Utility methods (I used inline functions to avoid creating an additional source file
 
@@ -62,11 +54,40 @@ inline string to_lowercase(string s)
     return s;
 }
 
+/** Utility function to append the lowercase version of a string to another string, reusing the memory of the latter
+ * @param s: string to turn into lowercase
+ * @param lowercase: string the lowercase characters are appended to
+*/
+inline void append_lowercase(string_view s, string& lowercase)
+{
+    for(char c: s){
+        lowercase.push_back(char(tolower((unsigned char)c)));
+    }
+}
+
+/** Utility function to compare two strings ignoring the case of their characters, without building lowercase copies
+ * @param a: first string to compare
+ * @param b: second string to compare
+ * @returns: boolean value indicating whether the strings are equal up to case
+*/
+inline bool equals_ignoring_case(string_view a, string_view b)
+{
+    if(a.size() != b.size()){
+        return false;
+    }
+    for(size_t i = 0; i < a.size(); i++){
+        if(tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
 /** Utility function to check if a given input string is made of strictly alphabetical characters
  * @param s: string to check
  * @returns: boolean value
 */
-inline bool validate_only_alphabetical_string(string& s)
+inline bool validate_only_alphabetical_string(string_view s)
 {
     for(char c: s)
     {
@@ -113,7 +134,7 @@ inline void trim_string(string& s) {
  * @param input_string: datetime string to be validated
  * @returns boolean value
 */
-inline bool validate_datetime_string(string input_string)
+inline bool validate_datetime_string(const string& input_string)
 {
 
     tm datetime_struct;
@@ -131,7 +152,8 @@ inline bool validate_datetime_string(string input_string)
     // check that the time fields make sense
     bool valid_year = datetime_struct.tm_year + 1900 >= 1900;
     bool valid_month = (datetime_struct.tm_mon +1  >= 1) && (datetime_struct.tm_mon +1 <= 12);
-    bool valid_day = (datetime_struct.tm_mday >= 1 && datetime_struct.tm_mday <= 31);
+    // the day must exist in the given month, as dates are stored as day numbers (e.g. 2021:02:31 would silently become 2021:03:03)
+    bool valid_day = chrono::year_month_day(chrono::year(datetime_struct.tm_year + 1900), chrono::month(datetime_struct.tm_mon + 1), chrono::day(datetime_struct.tm_mday)).ok();
 
     if(!(valid_year)){
         // cout << "Year not valid. ";
@@ -151,23 +173,101 @@ inline bool validate_datetime_string(string input_string)
 }
 
 
+/** Utility function to split a line of user input into its words, separated by whitespace, without copying them
+ * @param line: the line to split
+ * @param tokens: vector the views over the words are stored in, valid as long as the line is not modified
+*/
+inline void split_input_tokens(string_view line, vector<string_view>& tokens)
+{
+    tokens.clear();
+    size_t start = 0;
+    while(true){
+        while((start < line.size()) && isspace((unsigned char)line[start])){
+            start++;
+        }
+        if(start == line.size()){
+            return;
+        }
+        size_t end = start;
+        while((end < line.size()) && !isspace((unsigned char)line[end])){
+            end++;
+        }
+        tokens.push_back(line.substr(start, end - start));
+        start = end;
+    }
+}
+
+/** Utility functions to convert a word of user input into a value, one for each type of input read by ask_user_input.
+ * Numbers accept the same words as when read from a stream: an optional sign followed by the digits, with no text left after them
+ * @param token: the word to convert
+ * @param value: variable to store the value
+ * @returns boolean value indicating whether the whole word could be converted
+*/
+inline bool parse_input_value(string_view token, string& value)
+{
+    value.assign(token);
+    return true;
+}
+
+/** Removes the plus sign a number read from a stream may start with, which from_chars does not accept. The sign must be followed by a digit or a point */
+inline string_view strip_plus_sign(string_view token)
+{
+    if((token.size() > 1) && (token[0] == '+') && (token[1] != '-')){
+        token.remove_prefix(1);
+    }
+    return token;
+}
+
+inline bool parse_input_value(string_view token, int& value)
+{
+    token = strip_plus_sign(token);
+    const char* end = token.data() + token.size();
+    from_chars_result result = from_chars(token.data(), end, value);
+    return (result.ec == errc()) && (result.ptr == end);
+}
+
+inline bool parse_input_value(string_view token, float& value)
+{
+    // words such as inf, nan or hexadecimal numbers are not numbers for a stream, the first character after the sign must be a digit or a point
+    token = strip_plus_sign(token);
+    size_t first = ((!token.empty()) && (token[0] == '-')) ? 1 : 0;
+    if((first == token.size()) || !(isdigit((unsigned char)token[first]) || (token[first] == '.'))
+        || (token.find_first_of("xX") != string_view::npos)){
+        return false;
+    }
+
+#if defined(__cpp_lib_to_chars) && (__cpp_lib_to_chars >= 201611L)
+    const char* end = token.data() + token.size();
+    from_chars_result result = from_chars(token.data(), end, value);
+    return (result.ec == errc()) && (result.ptr == end);
+#else
+    // standard libraries without floating point from_chars: strtof needs a null terminated copy, kept between calls so that it is allocated only once
+    static thread_local string buffer;
+    buffer.assign(token);
+    char* end;
+    errno = 0;
+    value = strtof(buffer.c_str(), &end);
+    return (errno == 0) && (end == buffer.c_str() + buffer.size());
+#endif
+}
+
+
 /** Utility template that takes care of reading and parsing a whole line of user input (numbers and strings in practice), and stores the element in a vector for later use.
+ * The line is split into words without copying it, and the words are converted with parse_input_value. The buffers holding the line and its words are kept
+ * from one call to the next, so reading a line does not allocate memory once they are large enough (nor do the strings stored, when they are short).
  * @param user_input: vector of generic type T, meant to store the user's inputs
  * @param prompt: message to print to the user when asking for input
  * @returns boolean value indicating whether the user wants to cancel the operation for which input is being asked. True means cancel, False go on.
 */
 template<typename T>
-inline bool ask_user_input(vector<T>& user_input, string& prompt)
+inline bool ask_user_input(vector<T>& user_input, const string& prompt)
 {
-    string user_input_line;
-    T user_input_element;
+    static thread_local string user_input_line;
+    static thread_local vector<string_view> tokens;
 
 
     while(true){
 
-        user_input.clear();
-
-
         cout << prompt << endl;
         if (!getline(cin, user_input_line)){ // check if the input stream is in a good state after reading input from it
 
@@ -183,20 +283,23 @@ inline bool ask_user_input(vector<T>& user_input, string& prompt)
 
         trim_string(user_input_line);
         // check for cancel condition before further parsing. If cancel condition is satisfied return immediately
-        if(to_lowercase(user_input_line) == cancel_string){
+        if(equals_ignoring_case(user_input_line, cancel_string)){
+            user_input.clear();
             return true;
         }
 
 
-        stringstream ss(user_input_line); // load the user's input line into a stream string for later access to the values
-
-        // load the strings contained in the string stream into the vector
-        while (ss >> user_input_element) {
-            user_input.push_back(user_input_element);
+        // convert the words of the line into the elements of the vector. Resizing rather than clearing the vector lets the strings already in it
+        // keep their memory
+        split_input_tokens(user_input_line, tokens);
+        user_input.resize(tokens.size());
+        bool parsed = true;
+        for(size_t i = 0; (i < tokens.size()) && parsed; i++){
+            parsed = parse_input_value(tokens[i], user_input[i]);
         }
 
-        // Additional check: test if the entire string stream was correctly parsed
-        if (ss.fail() && !ss.eof()) {
+        // Additional check: test if the entire line was correctly parsed
+        if (!parsed) {
             cerr << error_msg << endl;
             continue;
         }
@@ -214,34 +317,35 @@ inline bool ask_user_input(vector<T>& user_input, string& prompt)
  * @param logger: shared pointer to the Logger class object so that logging can be executed during the method's execution
  * @returns boolean value indicating whether the user said yes or no
 */
-inline bool read_user_answer(string prompt, shared_ptr<Logger> logger){
+inline bool read_user_answer(const string& prompt, shared_ptr<Logger> logger){
    
-    vector<string> user_inputs;
-    string answer;
+    // kept between calls, see ask_user_input
+    static thread_local vector<string> user_inputs;
+    static thread_local string answer;
     while(true){
     
         logger->logfile << "Asking user yes/no question... " << endl;
 
         user_inputs.clear();
         ask_user_input(user_inputs, prompt);
-        logger->logfile << "Validating user answer... "; 
 
         // the user must type just one word
         if(user_inputs.size()!=1){
             cout << "You can only type one word" << endl;
-            logger->logfile << "Not valid" << endl;
+            LOG_TRACE(logger, "Validating user answer... Not valid");
             continue;
         }
 
         // make it lowercase to add a bit of flexibility
-        answer = to_lowercase(user_inputs[0]);
+        answer.clear();
+        append_lowercase(user_inputs[0], answer);
 
         // the user must type only one of the 2 possible answers
         if((answer!=yes_no_possible_answers[0])&&(answer)!=yes_no_possible_answers[1]){
             cout << "Invalid answer. Try again." << endl;
-            logger->logfile << "Not valid" << endl;
+            LOG_TRACE(logger, "Validating user answer... Not valid");
         }
-        logger->logfile << "Validated" << endl;
+        LOG_TRACE(logger, "Validating user answer... Validated");
         break;
     }
 
@@ -261,20 +365,19 @@ inline bool read_user_answer(string prompt, shared_ptr<Logger> logger){
  * @param exit_option: boolean flag to indicate that the user can indicate exit the current menu by typing -1 (needed only when selecting the result of a search, otherwise menus typically have
  * an action corresponding to exit)
 */
-inline void read_user_menu_choice(int& user_choice, int number_menu_possible_actions, string prompt, shared_ptr<Logger> logger, bool exit_option = false){
-    vector<int> user_inputs;
+inline void read_user_menu_choice(int& user_choice, int number_menu_possible_actions, const string& prompt, shared_ptr<Logger> logger, bool exit_option = false){
+    static thread_local vector<int> user_inputs;
     while(true){
         user_inputs.clear();
         ask_user_input(user_inputs, prompt);
 
         // the user must type just one number
-        logger->logfile << "Validating number of user input values... ";
         if(user_inputs.size()!=1){
             cout << endl << "You can only choose one action" << endl;
-            logger->logfile << "Not valid" << endl;
+            LOG_TRACE(logger, "Validating number of user input values... Not valid");
             continue;
         }
-        logger->logfile << "Validated" << endl;
+        LOG_TRACE(logger, "Validating number of user input values... Validated");
 
         user_choice = user_inputs[0];
 
@@ -284,17 +387,16 @@ inline void read_user_menu_choice(int& user_choice, int number_menu_possible_act
             }
         }
 
-        logger->logfile << "Validating user menu choice... ";
         if((user_choice < 0) or (user_choice > number_menu_possible_actions)){
             cout << endl << "Invalid input. The possible choices are :";
             for(int i = 0; i < number_menu_possible_actions; i++){
                 cout << " " << i+1;
             }
             cout << endl;
-            logger->logfile << "Not valid" << endl;
+            LOG_TRACE(logger, "Validating user menu choice {}... Not valid", user_choice);
             continue;
         }
-        logger->logfile << "Validated" << endl;
+        LOG_TRACE(logger, "Validating user menu choice {}... Validated", user_choice);
         break;
     }
 }
@@ -309,7 +411,7 @@ inline void read_user_menu_choice(int& user_choice, int number_menu_possible_act
  * @returns boolean value indicating whether the user wants to cancel the operation for which input is being asked. True means cancel, False go on.
 */
 inline bool read_user_input(float& user_input, string& prompt, shared_ptr<Logger> logger, bool positive_number_check = false){
-    vector<float> user_inputs;
+    static thread_local vector<float> user_inputs;
     
     while(true){
         if(ask_user_input(user_inputs, prompt)){ // the user wants to cancel the current operation
@@ -319,25 +421,23 @@ inline bool read_user_input(float& user_input, string& prompt, shared_ptr<Logger
         }
 
         // the user must insert exactly one value
-        logger->logfile << "Validating number of user input values... ";
         if(user_inputs.size() != 1){
             cout << "You must enter exactly 1 input value. Try again." << endl;
-            logger->logfile << "Not valid." << endl;
+            LOG_TRACE(logger, "Validating number of user input values... Not valid.");
             continue;
         }
-        logger->logfile << "Validated." << endl;
+        LOG_TRACE(logger, "Validating number of user input values... Validated.");
         
         user_input = user_inputs[0];
 
         // perform the non-negative check if required
         if(positive_number_check){ 
-            logger->logfile << "Validating non-negative user input number... " << endl;
             if(user_input < 0){
                 cout << invalid_money_message;
-                logger->logfile << "Not valid." << endl;
+                LOG_TRACE(logger, "Validating non-negative user input number {}... Not valid.", user_input);
                 continue;
             }
-            logger->logfile << "Validated." << endl;
+            LOG_TRACE(logger, "Validating non-negative user input number {}... Validated.", user_input);
         }
         break;
     }
@@ -366,38 +466,35 @@ inline bool read_user_input(vector<string>& user_inputs, string& prompt, shared_
 
         // check the number of words
         if(accepted_number_of_inputs > 0){
-            logger->logfile << "Validating number of user input values... ";
             if(user_inputs.size() != accepted_number_of_inputs){
                 cout << "You must enter exactly" << accepted_number_of_inputs << "input elements. Try again." << endl;
-                logger->logfile << "Not valid." << endl;
+                LOG_TRACE(logger, "Validating number of user input values... Not valid.");
                 continue;
             }
-            logger->logfile << "Validated." << endl;
+            LOG_TRACE(logger, "Validating number of user input values... Validated.");
         }
 
         // alphabetical check
         if(alphabetical_check){
-            logger->logfile << "Validating strictly alphabetical user input strings... ";
-            for(string user_string: user_inputs){
+            for(const string& user_string: user_inputs){
                 if(!(validate_only_alphabetical_string(user_string))){
                     cout << invalid_alphabetical_string_message << endl;
-                    logger->logfile << "Not valid." << endl;
+                    LOG_TRACE(logger, "Validating strictly alphabetical user input string {}... Not valid.", user_string);
                     continue;
                 }
             }
-            logger->logfile << "Validated." << endl;
+            LOG_TRACE(logger, "Validating strictly alphabetical user input strings... Validated.");
     
         }
 
         //datetime check
         if(datetime_check){
-            logger->logfile << "Validating user input datetime string... " << endl;
             if(!(validate_datetime_string(user_inputs[0]))){
                 cout << invalid_datetime_string_message << endl;
-                logger->logfile << "Not valid." << endl;
+                LOG_TRACE(logger, "Validating user input datetime string {}... Not valid.", user_inputs[0]);
                 continue;
             }
-            logger->logfile << "Validated." << endl;
+            LOG_TRACE(logger, "Validating user input datetime string {}... Validated.", user_inputs[0]);
         }
         break;
     }
@@ -420,15 +517,288 @@ inline bool validate_path(string& file_path) {
 }
 
 
-/** Utility function to convert a ctime struct into a string
- * @param t: struct from the ctime library to represent datetimes
- * @returns string representing the information containing in the tm struct
+/** Utility function to convert a datetime string in the date_format format into a day number, i.e. the number of days since 1970:01:01.
+ * Datetimes are stored as day numbers so that comparing them is a single integer comparison.
+ * @param datetime_string: the datetime string to convert
+ * @param days: variable to store the day number
+ * @returns boolean value indicating whether the string could be parsed
 */
-inline string format_tm(const tm& t) {
+inline bool parse_datetime_string(const string& datetime_string, int32_t& days)
+{
+    tm datetime_struct = {};
+    istringstream in(datetime_string);
+    in >> get_time(&datetime_struct, date_format.c_str());
+    if (in.fail()) {
+        return false;
+    }
+
+    chrono::year_month_day date(chrono::year(datetime_struct.tm_year + 1900), chrono::month(datetime_struct.tm_mon + 1), chrono::day(datetime_struct.tm_mday));
+    days = chrono::sys_days(date).time_since_epoch().count();
+    return true;
+}
+
+/** Utility function to convert a day number into the year, month and day it corresponds to
+ * @param days: number of days since 1970:01:01
+ * @returns the corresponding calendar date
+*/
+inline chrono::year_month_day datetime_from_days(int32_t days)
+{
+    return chrono::year_month_day(chrono::sys_days(chrono::days(days)));
+}
+
+/** Utility function to convert a day number into a string, in the same format used by the json data files
+ * @param days: number of days since 1970:01:01
+ * @returns string representing the date in the format %Y:%m:%d followed by a space
+*/
+inline string format_datetime_days(int32_t days) {
+    chrono::year_month_day date = datetime_from_days(days);
     ostringstream oss;
-    oss << std::put_time(&t, "%Y:%m:%d "); 
+    oss << int(date.year()) << ":" << setfill('0') << setw(2) << unsigned(date.month()) << ":" << setw(2) << unsigned(date.day()) << " ";
     return oss.str();  
 }
 
 
 
+/////////////////////////////////////////////////////////////////////
+// inverted gram indexes, used for substring searches on names. A gram index maps every substring of 1 to 3 characters (gram) of the indexed
+// lowercase strings to the sorted list of the positions of the strings containing it.
+
+/** Utility function to pack a gram of 1 to 3 characters into an integer key. The length is stored in the highest byte so that grams of different lengths never collide
+ * @param s: string containing the gram
+ * @param start: position of the first character of the gram
+ * @param length: number of characters of the gram
+ * @returns the key of the gram
+*/
+inline uint32_t gram_key(const string& s, size_t start, size_t length)
+{
+    uint32_t key = length << 24;
+    for(size_t i = 0; i < length; i++){
+        key |= uint32_t((unsigned char)s[start + i]) << (8 * (2 - i));
+    }
+    return key;
+}
+
+/** Utility function to collect the keys of all the grams of 1 to 3 characters contained in a string
+ * @param s: string to split into grams
+ * @param grams: vector the keys are appended to, possibly with repetitions
+*/
+inline void collect_grams(const string& s, vector<uint32_t>& grams)
+{
+    for(size_t length = 1; length <= 3; length++){
+        for(size_t start = 0; start + length <= s.size(); start++){
+            grams.push_back(gram_key(s, start, length));
+        }
+    }
+}
+
+/** Utility function to add a position to the lists of a set of grams
+ * @param index: the gram index
+ * @param grams: keys of the grams of the indexed string, possibly with repetitions
+ * @param position: position of the indexed string
+*/
+template<typename Position>
+inline void gram_index_insert(unordered_map<uint32_t, vector<Position>>& index, vector<uint32_t> grams, Position position)
+{
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    for(uint32_t gram: grams){
+        vector<Position>& positions = index[gram];
+        positions.insert(lower_bound(positions.begin(), positions.end(), position), position);
+    }
+}
+
+/** Utility function to retrieve from a gram index the positions of the strings which may contain a word.
+ * A word of up to 3 characters is contained in a string exactly when it is one of its grams. A longer word can only be contained in the strings containing
+ * all its trigrams, so the candidates are the intersection of their lists, computed starting from the shortest one.
+ * @param index: the gram index
+ * @param word: the lowercase word to look for, not empty
+ * @param candidates: vector the positions of the candidates are stored in, in increasing order
+ * @returns true if the candidates are known to contain the word, false if they still need to be verified
+*/
+template<typename Position>
+inline bool gram_index_candidates(const unordered_map<uint32_t, vector<Position>>& index, const string& word, vector<Position>& candidates)
+{
+    candidates.clear();
+
+    if(word.size() <= 3){
+        auto entry = index.find(gram_key(word, 0, word.size()));
+        if(entry != index.end()){
+            candidates = entry->second;
+        }
+        return true;
+    }
+
+    vector<const vector<Position>*> gram_lists;
+    for(size_t start = 0; start + 3 <= word.size(); start++){
+        auto entry = index.find(gram_key(word, start, 3));
+        if(entry == index.end()){
+            return true;
+        }
+        gram_lists.push_back(&(entry->second));
+    }
+    sort(gram_lists.begin(), gram_lists.end(), [](const vector<Position>* a, const vector<Position>* b){ return a->size() < b->size(); });
+
+    candidates = *(gram_lists[0]);
+    vector<Position> intersection;
+    for(size_t i = 1; (i < gram_lists.size()) && !(candidates.empty()); i++){
+        intersection.clear();
+        set_intersection(candidates.begin(), candidates.end(), gram_lists[i]->begin(), gram_lists[i]->end(), back_inserter(intersection));
+        candidates.swap(intersection);
+    }
+
+    // containing all the trigrams does not imply containing the word (e.g. "anan" in "ana nan")
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////
+// stamped gram indexes, for strings which are often removed (the customers). Every position has a stamp, and the lists hold the position and the stamp
+// it had when indexed: removing a string only changes the stamp of its position, which makes its entries stale. The stale entries of a list are
+// dropped the next time the list is read, and all of them once they make up half of the index. A position reused by a new string is appended to
+// the lists out of order, and merged into the sorted part of each list when the list is next read.
+
+/**
+ * @struct StampedGramList
+ * @brief Entries of a gram: the position in the high 32 bits and its stamp in the low ones, sorted up to sorted_size.
+ */
+struct StampedGramList
+{
+    vector<uint64_t> entries;
+    size_t sorted_size = 0;
+};
+
+/**
+ * @struct StampedGramIndex
+ * @brief Gram index whose positions can be removed in constant time.
+ */
+struct StampedGramIndex
+{
+    unordered_map<uint32_t, StampedGramList> lists;
+    vector<uint32_t> stamps;        // current stamp of each position
+    size_t entries = 0;             // entries of all the lists, stale ones included
+    size_t stale_entries = 0;
+};
+
+/** Utility function to add a position to the lists of a set of grams
+ * @param index: the gram index
+ * @param grams: keys of the grams of the indexed string, possibly with repetitions
+ * @param position: position of the indexed string, not indexed already
+*/
+inline void stamped_gram_index_insert(StampedGramIndex& index, vector<uint32_t> grams, uint32_t position)
+{
+    if(position >= index.stamps.size()){
+        index.stamps.resize(position + 1, 0);
+    }
+    uint64_t entry = (uint64_t(position) << 32) | index.stamps[position];
+
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    for(uint32_t gram: grams){
+        StampedGramList& list = index.lists[gram];
+        if((list.sorted_size == list.entries.size()) && (list.entries.empty() || (list.entries.back() < entry))){
+            list.sorted_size++;
+        }
+        list.entries.push_back(entry);
+    }
+    index.entries += grams.size();
+}
+
+/** Utility function to sort a list of a stamped gram index and drop its stale entries */
+inline void stamped_gram_list_refresh(StampedGramIndex& index, StampedGramList& list)
+{
+    if(list.sorted_size < list.entries.size()){
+        sort(list.entries.begin() + list.sorted_size, list.entries.end());
+        inplace_merge(list.entries.begin(), list.entries.begin() + list.sorted_size, list.entries.end());
+    }
+
+    size_t size = list.entries.size();
+    const vector<uint32_t>& stamps = index.stamps;
+    list.entries.erase(remove_if(list.entries.begin(), list.entries.end(), [&](uint64_t entry){ return stamps[entry >> 32] != uint32_t(entry); }), list.entries.end());
+    list.sorted_size = list.entries.size();
+    index.entries -= size - list.entries.size();
+    index.stale_entries -= size - list.entries.size();
+}
+
+/** Utility function to remove a position from a stamped gram index, by making its entries stale
+ * @param index: the gram index
+ * @param grams: keys of the grams of the indexed string, possibly with repetitions
+ * @param position: position of the indexed string
+*/
+inline void stamped_gram_index_erase(StampedGramIndex& index, vector<uint32_t> grams, uint32_t position)
+{
+    index.stamps[position]++;
+    sort(grams.begin(), grams.end());
+    index.stale_entries += unique(grams.begin(), grams.end()) - grams.begin();
+
+    // purging the whole index costs as much as the entries removed since the last purge, hence constant time per removal
+    if(2 * index.stale_entries > index.entries){
+        for(auto entry = index.lists.begin(); entry != index.lists.end();){
+            stamped_gram_list_refresh(index, entry->second);
+            entry = entry->second.entries.empty() ? index.lists.erase(entry) : next(entry);
+        }
+    }
+}
+
+/** Utility function to retrieve from a stamped gram index the positions of the strings which may contain a word, see gram_index_candidates.
+ * The lists read are refreshed first, which is why the index is not const
+ * @param index: the gram index
+ * @param word: the lowercase word to look for, not empty
+ * @param candidates: vector the positions of the candidates are stored in, in increasing order
+ * @returns true if the candidates are known to contain the word, false if they still need to be verified
+*/
+inline bool stamped_gram_index_candidates(StampedGramIndex& index, const string& word, vector<uint32_t>& candidates)
+{
+    candidates.clear();
+
+    vector<StampedGramList*> gram_lists;
+    size_t gram_length = min(word.size(), size_t(3));
+    for(size_t start = 0; start + gram_length <= word.size(); start++){
+        auto entry = index.lists.find(gram_key(word, start, gram_length));
+        if(entry == index.lists.end()){
+            return true;
+        }
+        stamped_gram_list_refresh(index, entry->second);
+        gram_lists.push_back(&(entry->second));
+    }
+    sort(gram_lists.begin(), gram_lists.end(), [](const StampedGramList* a, const StampedGramList* b){ return a->entries.size() < b->entries.size(); });
+
+    // a position has a single valid stamp, so the entries of a position are the same in all the lists
+    vector<uint64_t> entries = gram_lists[0]->entries;
+    vector<uint64_t> intersection;
+    for(size_t i = 1; (i < gram_lists.size()) && !(entries.empty()); i++){
+        intersection.clear();
+        set_intersection(entries.begin(), entries.end(), gram_lists[i]->entries.begin(), gram_lists[i]->entries.end(), back_inserter(intersection));
+        entries.swap(intersection);
+    }
+
+    candidates.reserve(entries.size());
+    for(uint64_t entry: entries){
+        candidates.push_back(uint32_t(entry >> 32));
+    }
+    // containing all the trigrams does not imply containing the word
+    return word.size() <= 3;
+}
+
+/** Utility function to rank how well a name matches a searched word, used to show the most relevant results first
+ * @param lowercase_name: the lowercase name
+ * @param word: the lowercase searched word
+ * @returns 0 if the name is the word (ignoring trailing spaces), 1 if it starts with the word, 2 if one of its words starts with the word,
+ * 3 if it contains the word elsewhere, -1 if it does not contain it
+*/
+inline int name_match_rank(const string& lowercase_name, const string& word)
+{
+    size_t position = lowercase_name.find(word);
+    if(position == string::npos){
+        return -1;
+    }
+    if(position == 0){
+        size_t end = lowercase_name.find_last_not_of(' ');
+        return ((end != string::npos) && (end + 1 == word.size())) ? 0 : 1;
+    }
+    // look for an occurrence at the start of a word
+    for(; position != string::npos; position = lowercase_name.find(word, position + 1)){
+        if(lowercase_name[position - 1] == ' '){
+            return 2;
+        }
+    }
+    return 3;
+}